@@ -22,6 +22,8 @@
 #define D5 5 // OUTPUT
 #define D6 18 // OUTPUT
 #define D7 19 // OUTPUT
+// The LCD is redrawn at most this often, draws in between are combined
+#define LCD_REFRESH_MS 50
 
 // ROTARY ENCODER
 #define RE_STEP_SIZE 20
@@ -30,6 +32,71 @@
 #define RE_DAT 23 // INPUT
 #define RE_VALUE_MAX 5
 #define RE_VALUE_MIN 0
+// Quadrature transitions between two detents of the Rotary Encoder
+#define RE_STEPS_PER_DETENT 4
+// Percent of the door one detent of the Rotary Encoder moves it by
+#define RE_SCRUB_PERCENT 5
 
 // MICRO SERVO
-#define SERVO 13
\ No newline at end of file
+#define SERVO 13
+#define SERVO_ANGLE_MIN 0
+#define SERVO_ANGLE_MAX 180
+// Time to move the servo by one degree, 180 degrees in about 5 seconds
+#define SERVO_MS_PER_DEGREE 28
+
+// DOORS
+// Doors driven by the device, each by its own servo. The touch sensor, the
+// Rotary Encoder and the LCD act on one door at a time. A build can set it,
+// for example with -D DOOR_COUNT=3
+#ifndef DOOR_COUNT
+#define DOOR_COUNT 1
+#endif
+// The servo pin of every door, door 0 first
+#define DOOR_SERVO_PINS { SERVO, 25, 26, 27 }
+
+// NETWORK
+// Dirty AtKey values are written together at most this often
+#define AT_CACHE_FLUSH_MS 500
+// A write that was not acknowledged after this long is given up on and
+// written again
+#define AT_CACHE_IN_FLIGHT_MS 120000
+// app_e is read this often while the monitor is not connected. The ESP32
+// build has no monitor connection (lib/hal/monitor_transport.cpp), on the
+// device every command arrives through this poll.
+#define APP_E_POLL_MS 15000
+// APP_TOKEN_SECRET, the secret of ROLLING_TOKEN_KEY_SIZE characters shared
+// with the client Application, is provisioned in include/secrets.h, which is
+// not in the repository. Copy include/secrets.h.example to start it.
+#if __has_include("secrets.h")
+#include "secrets.h"
+#else
+#error "include/secrets.h is missing, copy include/secrets.h.example and set APP_TOKEN_SECRET"
+#endif
+
+// PERSISTENCE
+// The snapshot of the device in flash is brought up to date at most this often
+#define DEVICE_STATE_SAVE_MS 2000
+// The door cycles in flash are brought up to date at most this often
+#define CYCLE_LOG_SAVE_MS 300000
+
+// POWER
+// The main loop waits at most this long while it has nothing to do, the
+// serial console is read at least this often
+#define IDLE_MAX_SLEEP_MS 1000
+// Shorter waits are not worth the wake up, the loop spins through them
+#define IDLE_MIN_SLEEP_MS 2
+
+// DIAGNOSTICS
+// Sending this character over serial prints the latency statistics
+#define STATS_DUMP_KEY 's'
+// How often the compact telemetry AtKey is published, 0 to never publish it
+#define TELEMETRY_PUBLISH_MS 0
+// Door cycles wait at most this long for more before they are uploaded
+// to door_cycles together
+#define CYCLE_UPLOAD_MS 30000
+// Log records of a higher level than this are compiled out, LOG_LEVEL_ERROR
+// to LOG_LEVEL_DEBUG from log_ring.h. A build can set it, for example with
+// -D LOG_LEVEL=LOG_LEVEL_DEBUG
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
@@ -0,0 +1,88 @@
+/**
+ * Author: Malav Patel
+ * Description: Purpose of this file is to implement the
+ * AppBatch encoding defined in app_command.h
+ */
+#include "app_command.h"
+
+#include "base64.h"
+
+// Sizes of the header and of a record with every field of this version
+static const size_t HEADER_SIZE = 6;
+static const size_t RECORD_SIZE = 6;
+// Longest frame that is decoded, records of later versions may be longer
+static const size_t FRAME_MAX = 64;
+
+bool AppBatch::decode(const char* text, AppBatch& batch)
+{
+    static_assert(APP_BATCH_EVENTS * APP_BATCH_DOORS == 256, "An event and a door share a byte");
+    uint8_t frame[FRAME_MAX];
+    if (text[0] != APP_BATCH_MARKER) {
+        return false;
+    }
+    int length = base64_decode(text + 1, frame, sizeof(frame));
+    // Version 1 is refused too, its token of 2 bytes would never be accepted
+    if (length < 1 || frame[0] != APP_BATCH_VERSION) {
+        return false;
+    }
+    if (length < (int)HEADER_SIZE || frame[HEADER_SIZE - 1] > APP_BATCH_MAX) {
+        return false;
+    }
+
+    batch.token = (uint32_t)frame[1] | (uint32_t)frame[2] << 8 | (uint32_t)frame[3] << 16 | (uint32_t)frame[4] << 24;
+    batch.count = frame[HEADER_SIZE - 1];
+
+    int at = HEADER_SIZE;
+    for (uint8_t i = 0; i < batch.count; i++) {
+        if (at >= length) {
+            return false;
+        }
+        int record = frame[at++];
+        if (record < 3 || at + record > length) {
+            return false;
+        }
+        AppCommand& command = batch.commands[i];
+        command.sequence = (uint16_t)(frame[at] | frame[at + 1] << 8);
+        command.event = frame[at + 2] % APP_BATCH_EVENTS;
+        command.door = frame[at + 2] / APP_BATCH_EVENTS;
+        command.value = record >= 5 ? (int16_t)(frame[at + 3] | frame[at + 4] << 8) : 0;
+        at += record;
+    }
+    return true;
+}
+
+size_t AppBatch::encode(const AppBatch& batch, char* text, size_t size)
+{
+    uint8_t frame[FRAME_MAX];
+    if (batch.count > APP_BATCH_MAX) {
+        return 0;
+    }
+
+    size_t length = 0;
+    frame[length++] = APP_BATCH_VERSION;
+    frame[length++] = (uint8_t)batch.token;
+    frame[length++] = (uint8_t)(batch.token >> 8);
+    frame[length++] = (uint8_t)(batch.token >> 16);
+    frame[length++] = (uint8_t)(batch.token >> 24);
+    frame[length++] = batch.count;
+    for (uint8_t i = 0; i < batch.count; i++) {
+        const AppCommand& command = batch.commands[i];
+        frame[length++] = RECORD_SIZE - 1;
+        frame[length++] = (uint8_t)command.sequence;
+        frame[length++] = (uint8_t)(command.sequence >> 8);
+        frame[length++] = (uint8_t)(command.event % APP_BATCH_EVENTS + command.door % APP_BATCH_DOORS * APP_BATCH_EVENTS);
+        frame[length++] = (uint8_t)command.value;
+        frame[length++] = (uint8_t)((uint16_t)command.value >> 8);
+    }
+
+    // The marker, then the frame
+    if (size < 2) {
+        return 0;
+    }
+    size_t written = base64_encode(frame, length, text + 1, size - 1);
+    if (written == 0) {
+        return 0;
+    }
+    text[0] = APP_BATCH_MARKER;
+    return written + 1;
+}
@@ -0,0 +1,83 @@
+/**
+ * Author: Malav Patel
+ * Description: Purpose of this file is to define the format the client
+ * Application uses to send several commands to the device in one value of
+ * app_events_key.
+ */
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Version of the format written by encode()
+#define APP_BATCH_VERSION 2
+// Most commands one batch can carry, a full batch is 57 characters so it
+// fits in the values NetWorker and AtMonitor hand to the main loop
+#define APP_BATCH_MAX 6
+// First character of an encoded batch, a legacy "<event_id>z<token>" value
+// always starts with a digit
+#define APP_BATCH_MARKER '!'
+// Events a command can carry, and doors it can address, the two share a byte
+#define APP_BATCH_EVENTS 32
+#define APP_BATCH_DOORS 8
+
+/**
+ * One command of a batch: the Event the client Application asks for and the
+ * door it is for, with a sequence number so it is applied once however often
+ * the batch is read.
+ */
+struct AppCommand {
+    uint16_t sequence;
+    uint8_t event;
+    int16_t value;
+    uint8_t door;
+};
+
+/**
+ * A batch of commands as carried by app_events_key. On the wire it is the
+ * marker followed by the base64 of:
+ *
+ *   version (1 byte), token (4 bytes), count (1 byte),
+ *   count records of: length (1 byte, bytes of the record that follow),
+ *                     sequence (2 bytes), event (1 byte), value (2 bytes)
+ *
+ * The event byte carries the Event in its low 5 bits and the door in its high
+ * 3 bits, so a batch of a client Application that only knows one door
+ * addresses door 0.
+ * Version 1 had a token of 2 bytes, which can never be a RollingToken of 31
+ * bits, so its batches are refused like any unknown version.
+ * Numbers are little endian. A record may be longer than the fields known
+ * to this version, the rest of it is skipped, and a record shorter than 5
+ * bytes has a value of 0. Nothing is allocated when decoding.
+ */
+struct AppBatch {
+    uint32_t token;
+    uint8_t count;
+    AppCommand commands[APP_BATCH_MAX];
+
+    /**
+     * Description: Decode a batch from the value of app_events_key.
+     * Pre: text is a null terminated string.
+     * Post: Returns false, leaving batch undefined, if text is not a
+     * complete batch of a known version.
+     */
+    static bool decode(const char* text, AppBatch& batch);
+
+    /**
+     * Description: Encode a batch the way the client Application does.
+     * Pre: batch.count is at most APP_BATCH_MAX.
+     * Post: Returns the length written to text without the null terminator,
+     * or 0 if it does not fit in size.
+     */
+    static size_t encode(const AppBatch& batch, char* text, size_t size);
+};
+
+/**
+ * Description: Checks if sequence is newer than last, allowing the sequence
+ * numbers to wrap around.
+ * Pre: None
+ * Post: Returns true if sequence comes after last.
+ */
+inline bool app_sequence_newer(uint16_t sequence, uint16_t last)
+{
+    return (int16_t)(uint16_t)(sequence - last) > 0;
+}
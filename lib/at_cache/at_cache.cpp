@@ -0,0 +1,318 @@
+/**
+ * Author: Malav Patel
+ * Description: Purpose of this file is to implement the
+ * AtKeyCache Class defined in at_cache.h
+ */
+#include "at_cache.h"
+
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+AtKeyCache::AtKeyCache()
+    : count(0)
+    , last_flush(0)
+    , sets(0)
+    , writes(0)
+    , avoided(0)
+    , failed(0)
+    , stale(0)
+    , expired(0)
+    , pending_high(0)
+{
+}
+
+AtKeyCache::Entry* AtKeyCache::find(const AtKey* key)
+{
+    for (size_t i = 0; i < count; i++) {
+        if (entries[i].key == key) {
+            return &entries[i];
+        }
+    }
+    return nullptr;
+}
+
+const AtKeyCache::Entry* AtKeyCache::find(const AtKey* key) const
+{
+    return const_cast<AtKeyCache*>(this)->find(key);
+}
+
+void AtKeyCache::count_pending()
+{
+    size_t pending = pending_count();
+    if (pending > pending_high) {
+        pending_high = pending;
+    }
+}
+
+bool AtKeyCache::track(const AtKey* key)
+{
+    if (find(key) != nullptr) {
+        return true;
+    }
+    if (count == AT_CACHE_KEYS) {
+        return false;
+    }
+
+    Entry& entry = entries[count++];
+    entry.key = key;
+    entry.acked[0] = '\0';
+    entry.in_flight[0] = '\0';
+    entry.pending[0] = '\0';
+    entry.sent_at = 0;
+    entry.has_acked = false;
+    entry.is_in_flight = false;
+    entry.is_dirty = false;
+    return true;
+}
+
+void AtKeyCache::set(const AtKey* key, const char* value)
+{
+    Entry* entry = find(key);
+    if (entry == nullptr || strlen(value) >= NET_VALUE_MAX) {
+        return;
+    }
+    sets++;
+
+    // The value the server will have once everything already sent lands
+    const char* latest = entry->is_in_flight ? entry->in_flight
+        : entry->has_acked                   ? entry->acked
+                                             : nullptr;
+
+    if (latest != nullptr && strcmp(latest, value) == 0) {
+        // Either nothing changed, or it changed back before it was written
+        entry->is_dirty = false;
+        avoided++;
+        return;
+    }
+
+    if (entry->is_dirty) {
+        // Replaces a value that was never written
+        avoided++;
+    }
+    strcpy(entry->pending, value);
+    entry->is_dirty = true;
+    count_pending();
+}
+
+void AtKeyCache::set(const AtKey* key, long value)
+{
+    char text[24];
+    snprintf(text, sizeof(text), "%ld", value);
+    set(key, text);
+}
+
+void AtKeyCache::seed(const AtKey* key, long value)
+{
+    Entry* entry = find(key);
+    if (entry == nullptr || entry->is_in_flight || entry->is_dirty) {
+        return;
+    }
+    snprintf(entry->acked, sizeof(entry->acked), "%ld", value);
+    entry->has_acked = true;
+}
+
+bool AtKeyCache::acked(const AtKey* key, long& value) const
+{
+    const Entry* entry = find(key);
+    if (entry == nullptr || !entry->has_acked || entry->acked[0] == '\0') {
+        return false;
+    }
+    char* end;
+    value = strtol(entry->acked, &end, 10);
+    return *end == '\0';
+}
+
+void AtKeyCache::reconcile(const NetCompletion& completion)
+{
+    Entry* entry = find(completion.key);
+    if (entry == nullptr || completion.op != NetOp::get || !completion.ok) {
+        return;
+    }
+    // A write in flight will decide what the server has anyway
+    if (entry->is_in_flight || (entry->has_acked && strcmp(entry->acked, completion.value) == 0)) {
+        return;
+    }
+
+    stale++;
+    if (entry->is_dirty) {
+        if (strcmp(entry->pending, completion.value) == 0) {
+            // The server already has what was about to be written
+            entry->is_dirty = false;
+            avoided++;
+        }
+    } else if (entry->has_acked) {
+        strcpy(entry->pending, entry->acked);
+        entry->is_dirty = true;
+        count_pending();
+    }
+    strcpy(entry->acked, completion.value);
+    entry->has_acked = true;
+}
+
+bool AtKeyCache::dirty() const
+{
+    for (size_t i = 0; i < count; i++) {
+        if (entries[i].is_dirty) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool AtKeyCache::settled(const AtKey* key) const
+{
+    const Entry* entry = find(key);
+    return entry != nullptr && !entry->is_dirty && !entry->is_in_flight;
+}
+
+bool AtKeyCache::flush_due(unsigned long now, unsigned long interval) const
+{
+    return now - last_flush >= interval && dirty();
+}
+
+unsigned long AtKeyCache::flush_in(unsigned long now, unsigned long interval) const
+{
+    if (!dirty()) {
+        return ULONG_MAX;
+    }
+    unsigned long since = now - last_flush;
+    return since >= interval ? 0 : interval - since;
+}
+
+size_t AtKeyCache::flush(NetWorker& worker, unsigned long now)
+{
+    size_t posted = 0;
+    last_flush = now;
+    if (!worker.connected()) {
+        return 0;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        Entry& entry = entries[i];
+        if (!entry.is_dirty) {
+            continue;
+        }
+        if (!worker.post_put(entry.key, entry.pending)) {
+            continue;
+        }
+        strcpy(entry.in_flight, entry.pending);
+        entry.sent_at = now;
+        entry.is_in_flight = true;
+        entry.is_dirty = false;
+        writes++;
+        posted++;
+    }
+    return posted;
+}
+
+size_t AtKeyCache::expire(unsigned long now, unsigned long timeout)
+{
+    size_t given_up = 0;
+    for (size_t i = 0; i < count; i++) {
+        Entry& entry = entries[i];
+        if (!entry.is_in_flight || now - entry.sent_at < timeout) {
+            continue;
+        }
+        // Written again like a write that failed, a late completion of it
+        // only updates the acknowledged value
+        entry.is_in_flight = false;
+        if (!entry.is_dirty) {
+            strcpy(entry.pending, entry.in_flight);
+            entry.is_dirty = true;
+        }
+        expired++;
+        given_up++;
+    }
+    if (given_up > 0) {
+        count_pending();
+    }
+    return given_up;
+}
+
+unsigned long AtKeyCache::expire_in(unsigned long now, unsigned long timeout) const
+{
+    unsigned long wait = ULONG_MAX;
+    for (size_t i = 0; i < count; i++) {
+        const Entry& entry = entries[i];
+        if (!entry.is_in_flight) {
+            continue;
+        }
+        unsigned long since = now - entry.sent_at;
+        unsigned long left = since >= timeout ? 0 : timeout - since;
+        wait = left < wait ? left : wait;
+    }
+    return wait;
+}
+
+void AtKeyCache::acknowledge(const NetCompletion& completion)
+{
+    Entry* entry = find(completion.key);
+    if (entry == nullptr || completion.op != NetOp::put) {
+        return;
+    }
+
+    // Only the last write that was sent counts as in flight
+    bool latest = entry->is_in_flight && strcmp(entry->in_flight, completion.value) == 0;
+    if (latest) {
+        entry->is_in_flight = false;
+    }
+
+    if (completion.ok) {
+        strcpy(entry->acked, completion.value);
+        entry->has_acked = true;
+        return;
+    }
+
+    failed++;
+    if (latest && !entry->is_dirty) {
+        strcpy(entry->pending, completion.value);
+        entry->is_dirty = true;
+        count_pending();
+    }
+}
+
+uint32_t AtKeyCache::set_count() const
+{
+    return sets;
+}
+
+uint32_t AtKeyCache::write_count() const
+{
+    return writes;
+}
+
+uint32_t AtKeyCache::avoided_count() const
+{
+    return avoided;
+}
+
+uint32_t AtKeyCache::failed_count() const
+{
+    return failed;
+}
+
+uint32_t AtKeyCache::expired_count() const
+{
+    return expired;
+}
+
+uint32_t AtKeyCache::stale_count() const
+{
+    return stale;
+}
+
+size_t AtKeyCache::pending_count() const
+{
+    size_t pending = 0;
+    for (size_t i = 0; i < count; i++) {
+        pending += entries[i].is_dirty ? 1 : 0;
+    }
+    return pending;
+}
+
+size_t AtKeyCache::pending_high_water() const
+{
+    return pending_high;
+}
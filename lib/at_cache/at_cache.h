@@ -0,0 +1,204 @@
+/**
+ * Author: Malav Patel
+ * Description: Purpose of this file is to define a helper class
+ * AtKeyCache that keeps a local copy of every AtKey value the device
+ * publishes, so that only values that actually changed are written to the
+ * AtSign secondary server.
+ */
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+#include "hal.h"
+#include "net_worker.h"
+
+// Number of AtKeys the cache can track
+#define AT_CACHE_KEYS 16
+
+/**
+ * A helper class AtKeyCache remembers, for every tracked AtKey, the value the
+ * server last acknowledged, the value that is in flight and the value that is
+ * waiting to be written. set() only marks a key dirty when the value differs
+ * from what the server has or is about to have, and flush() posts every dirty
+ * key to the NetWorker in one go. A key that is set several times between
+ * flushes is written once with the last value.
+ *
+ * The dirty keys are the outbox of the device. While the NetWorker is not
+ * connected flush() posts nothing, a write that failed makes its key dirty
+ * again, and setting a key again only replaces its pending value, so once
+ * the link is back every key is written once, with its latest value.
+ *
+ * A write that was never acknowledged, because its completion was lost or
+ * the network task is stuck, must not keep its key in flight for good.
+ * expire() gives up on writes in flight for longer than a timeout and makes
+ * their keys dirty again, so they are written once more.
+ */
+class AtKeyCache {
+    struct Entry {
+        const AtKey* key;
+        char acked[NET_VALUE_MAX];
+        char in_flight[NET_VALUE_MAX];
+        char pending[NET_VALUE_MAX];
+        unsigned long sent_at;
+        bool has_acked;
+        bool is_in_flight;
+        bool is_dirty;
+    };
+
+    Entry entries[AT_CACHE_KEYS];
+    size_t count;
+
+    unsigned long last_flush;
+
+    uint32_t sets;
+    uint32_t writes;
+    uint32_t avoided;
+    uint32_t failed;
+    uint32_t stale;
+    uint32_t expired;
+    size_t pending_high;
+
+    Entry* find(const AtKey* key);
+    const Entry* find(const AtKey* key) const;
+    void count_pending();
+
+public:
+    AtKeyCache();
+
+    /**
+     * Description: Start tracking a key.
+     * Pre: Called during setup, at most AT_CACHE_KEYS keys.
+     * Post: Returns false if the cache is full.
+     */
+    bool track(const AtKey* key);
+
+    /**
+     * Description: Set the value a tracked key should have on the server.
+     * Pre: key is tracked and value is shorter than NET_VALUE_MAX.
+     * Post: The key is dirty if the value differs from the last acknowledged
+     * or in flight value, otherwise the write is counted as avoided.
+     */
+    void set(const AtKey* key, const char* value);
+
+    /**
+     * Description: Set the value a tracked key should have on the server to a
+     * number, formatted without allocating.
+     * Pre: key is tracked.
+     * Post: Same as set() with the decimal value.
+     */
+    void set(const AtKey* key, long value);
+
+    /**
+     * Description: Record the value the server is believed to have for a key,
+     * restored from flash at boot, without writing it.
+     * Pre: key is tracked and nothing was set or written for it yet.
+     * Post: The value is the acknowledged value, a set() of the same value
+     * is avoided.
+     */
+    void seed(const AtKey* key, long value);
+
+    /**
+     * Description: The value the server last acknowledged for a key.
+     * Pre: None
+     * Post: Returns false if key is not tracked, has no acknowledged value or
+     * it is not a number, otherwise value is set to it.
+     */
+    bool acked(const AtKey* key, long& value) const;
+
+    /**
+     * Description: Compare the value read back from the server for a tracked
+     * key with the value the cache believes it has.
+     * Pre: completion is a get completion from the network task.
+     * Post: If the server has something else, that becomes the acknowledged
+     * value and the value the key should have is dirty again.
+     */
+    void reconcile(const NetCompletion& completion);
+
+    /**
+     * Description: Checks if any key is waiting to be written.
+     * Pre: None
+     * Post: Returns true if flush() would post a request.
+     */
+    bool dirty() const;
+
+    /**
+     * Description: Checks if the server has the last value set for a key.
+     * Pre: None
+     * Post: Returns true if key is tracked and neither waiting to be written
+     * nor in flight.
+     */
+    bool settled(const AtKey* key) const;
+
+    /**
+     * Description: Checks if a flush is due on the cadence.
+     * Pre: None
+     * Post: Returns true if a key is dirty and interval ms have passed since
+     * the last flush.
+     */
+    bool flush_due(unsigned long now, unsigned long interval) const;
+
+    /**
+     * Description: Time until flush_due() becomes true.
+     * Pre: None
+     * Post: Returns milliseconds, 0 if a flush is due already and ULONG_MAX
+     * if no key is dirty.
+     */
+    unsigned long flush_in(unsigned long now, unsigned long interval) const;
+
+    /**
+     * Description: Post a put of every dirty key to the network task.
+     * Pre: None
+     * Post: Dirty keys that were posted are in flight, keys that could not be
+     * posted, or all of them while worker is not connected, stay dirty.
+     * Returns the number of requests posted.
+     */
+    size_t flush(NetWorker& worker, unsigned long now);
+
+    /**
+     * Description: Give up on writes that were posted timeout ms ago or
+     * earlier and are still in flight.
+     * Pre: None
+     * Post: Their keys are not in flight, and dirty with the value that was
+     * sent unless a newer one is waiting. Returns the number given up on.
+     */
+    size_t expire(unsigned long now, unsigned long timeout);
+
+    /**
+     * Description: Time until expire() gives up on a write.
+     * Pre: None
+     * Post: Returns milliseconds, 0 if a write is overdue and ULONG_MAX if
+     * no write is in flight.
+     */
+    unsigned long expire_in(unsigned long now, unsigned long timeout) const;
+
+    /**
+     * Description: Record the result of a put of a tracked key.
+     * Pre: completion is a put completion from the network task.
+     * Post: On success the value becomes the acknowledged value, on failure
+     * the key is dirty again unless a newer value is already waiting.
+     */
+    void acknowledge(const NetCompletion& completion);
+
+    /**
+     * Description: Counters of set() calls, writes posted, writes avoided
+     * because nothing changed or a newer value replaced a pending one, and
+     * writes that failed, writes given up on by expire() and of keys
+     * reconcile() found stale on the server.
+     * Pre: None
+     * Post: Returns the count since boot.
+     */
+    uint32_t set_count() const;
+    uint32_t write_count() const;
+    uint32_t avoided_count() const;
+    uint32_t failed_count() const;
+    uint32_t expired_count() const;
+    uint32_t stale_count() const;
+
+    /**
+     * Description: Keys waiting to be written, and the most that ever were.
+     * Pre: None
+     * Post: Returns the depth of the outbox.
+     */
+    size_t pending_count() const;
+    size_t pending_high_water() const;
+};
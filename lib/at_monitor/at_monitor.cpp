@@ -0,0 +1,313 @@
+/**
+ * Author: Malav Patel
+ * Description: Purpose of this file is to implement the
+ * AtMonitor Class defined in at_monitor.h
+ */
+#include "at_monitor.h"
+
+#include <cstring>
+
+static const char NOTIFICATION_PREFIX[] = "notification:";
+
+AtMonitor::AtMonitor()
+    : transport(nullptr)
+    , regex("")
+    , on_notify(nullptr)
+    , is_connected(false)
+    , running(false)
+    , received(0)
+    , dropped(0)
+    , connects(0)
+#ifdef ARDUINO
+    , task(nullptr)
+#elif defined(SIM_DETERMINISTIC)
+    , retry_at(0)
+#endif
+{
+}
+
+#if !defined(ARDUINO) && !defined(SIM_DETERMINISTIC)
+
+AtMonitor::~AtMonitor()
+{
+    if (!thread.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        running = false;
+    }
+    wake.notify_all();
+    thread.join();
+}
+
+#else
+
+AtMonitor::~AtMonitor()
+{
+}
+
+#endif
+
+#ifdef ARDUINO
+
+void AtMonitor::task_entry(void* self)
+{
+    static_cast<AtMonitor*>(self)->run();
+}
+
+void AtMonitor::start(MonitorTransport* transport, const char* regex, void (*on_notify)())
+{
+    if (transport == nullptr) {
+        return;
+    }
+    this->transport = transport;
+    this->regex = regex;
+    this->on_notify = on_notify;
+    running = true;
+    xTaskCreatePinnedToCore(task_entry, "at_monitor", MONITOR_TASK_STACK, this, 1, &task, MONITOR_TASK_CORE);
+}
+
+void AtMonitor::stop()
+{
+}
+
+void AtMonitor::retry_delay()
+{
+    vTaskDelay(pdMS_TO_TICKS(MONITOR_RETRY_MS));
+}
+
+#elif defined(SIM_DETERMINISTIC)
+
+void AtMonitor::step(void* self)
+{
+    static_cast<AtMonitor*>(self)->run();
+}
+
+void AtMonitor::start(MonitorTransport* transport, const char* regex, void (*on_notify)())
+{
+    if (transport == nullptr) {
+        return;
+    }
+    this->transport = transport;
+    this->regex = regex;
+    this->on_notify = on_notify;
+    running = true;
+    hal_sim::add_task(step, this);
+}
+
+void AtMonitor::stop()
+{
+    running = false;
+}
+
+void AtMonitor::retry_delay()
+{
+    retry_at = millis() + MONITOR_RETRY_MS;
+}
+
+// Same states as the threaded run() below, but returns instead of blocking
+void AtMonitor::run()
+{
+    static char line[MONITOR_LINE_MAX];
+
+    if (!running) {
+        return;
+    }
+    if (!is_connected) {
+        if ((long)(millis() - retry_at) < 0) {
+            return;
+        }
+        if (!transport->open(regex)) {
+            retry_delay();
+            return;
+        }
+        connects.fetch_add(1, std::memory_order_relaxed);
+        is_connected = true;
+    }
+
+    while (transport->readable()) {
+        if (transport->read_line(line, sizeof(line)) < 0) {
+            is_connected = false;
+            transport->close();
+            retry_delay();
+            return;
+        }
+        handle_line(line);
+    }
+}
+
+#else
+
+void AtMonitor::start(MonitorTransport* transport, const char* regex, void (*on_notify)())
+{
+    if (transport == nullptr) {
+        return;
+    }
+    this->transport = transport;
+    this->regex = regex;
+    this->on_notify = on_notify;
+    running = true;
+    thread = std::thread(&AtMonitor::run, this);
+}
+
+void AtMonitor::stop()
+{
+    if (!thread.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        running = false;
+    }
+    wake.notify_all();
+    transport->close();
+    thread.join();
+}
+
+void AtMonitor::retry_delay()
+{
+    std::unique_lock<std::mutex> guard(lock);
+    wake.wait_for(guard, std::chrono::milliseconds(MONITOR_RETRY_MS), [this] { return !running; });
+}
+
+#endif
+
+#ifndef SIM_DETERMINISTIC
+
+void AtMonitor::run()
+{
+    static char line[MONITOR_LINE_MAX];
+
+    while (running) {
+        if (!transport->open(regex)) {
+            retry_delay();
+            continue;
+        }
+        connects.fetch_add(1, std::memory_order_relaxed);
+        is_connected = true;
+
+        while (running && transport->read_line(line, sizeof(line)) >= 0) {
+            handle_line(line);
+        }
+
+        is_connected = false;
+        transport->close();
+        if (running) {
+            retry_delay();
+        }
+    }
+}
+
+#endif
+
+void AtMonitor::handle_line(const char* line)
+{
+    MonitorNotification notification;
+    if (strncmp(line, NOTIFICATION_PREFIX, sizeof(NOTIFICATION_PREFIX) - 1) != 0) {
+        return;
+    }
+    if (!parse(line, regex, notification.value, sizeof(notification.value))) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    if (!notifications.push(notification)) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    received.fetch_add(1, std::memory_order_relaxed);
+    if (on_notify != nullptr) {
+        on_notify();
+    }
+}
+
+/**
+ * Find a JSON string field and return a pointer to the first character of
+ * its value, or nullptr if the field is not in the line.
+ */
+static const char* find_field(const char* line, const char* name)
+{
+    char pattern[32];
+    size_t length = strlen(name);
+    if (length + 5 > sizeof(pattern)) {
+        return nullptr;
+    }
+    pattern[0] = '"';
+    memcpy(pattern + 1, name, length);
+    memcpy(pattern + 1 + length, "\":\"", 4);
+
+    const char* at = strstr(line, pattern);
+    return at == nullptr ? nullptr : at + length + 4;
+}
+
+bool AtMonitor::parse(const char* line, const char* regex, char* value, size_t size)
+{
+    const char* key = find_field(line, "key");
+    if (key == nullptr) {
+        return false;
+    }
+    const char* key_end = strchr(key, '"');
+    size_t regex_length = strlen(regex);
+    bool matched = false;
+    for (const char* at = key; key_end != nullptr && at + regex_length <= key_end; at++) {
+        if (strncmp(at, regex, regex_length) == 0) {
+            matched = true;
+            break;
+        }
+    }
+    if (!matched) {
+        return false;
+    }
+
+    const char* at = find_field(line, "value");
+    if (at == nullptr) {
+        return false;
+    }
+
+    size_t length = 0;
+    while (*at != '"') {
+        if (*at == '\0') {
+            return false;
+        }
+        if (*at == '\\' && at[1] != '\0') {
+            at++;
+        }
+        if (length + 1 >= size) {
+            return false;
+        }
+        value[length++] = *at++;
+    }
+    value[length] = '\0';
+    return true;
+}
+
+bool AtMonitor::connected() const
+{
+    return is_connected;
+}
+
+bool AtMonitor::take_notification(MonitorNotification& notification)
+{
+    const MonitorNotification* next = notifications.peek();
+    if (next == nullptr) {
+        return false;
+    }
+    notification = *next;
+    notifications.pop();
+    return true;
+}
+
+uint32_t AtMonitor::received_count() const
+{
+    return received.load(std::memory_order_relaxed);
+}
+
+uint32_t AtMonitor::dropped_count() const
+{
+    return dropped.load(std::memory_order_relaxed);
+}
+
+uint32_t AtMonitor::connect_count() const
+{
+    return connects.load(std::memory_order_relaxed);
+}
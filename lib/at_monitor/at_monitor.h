@@ -0,0 +1,143 @@
+/**
+ * Author: Malav Patel
+ * Description: Purpose of this file is to define a helper class
+ * AtMonitor that keeps a monitor connection open to the AtSign secondary
+ * server so that updates from the client Application are pushed to the
+ * device instead of being polled.
+ */
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "event_bus.h"
+#include "hal.h"
+
+#ifdef ARDUINO
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#elif !defined(SIM_DETERMINISTIC)
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
+
+// Longest notification value that is kept
+#define MONITOR_VALUE_MAX 64
+// Longest notification line that is read
+#define MONITOR_LINE_MAX 512
+// Number of notifications that can be waiting for the main loop
+#define MONITOR_QUEUE_SIZE 8
+// Time to wait before opening the monitor again after it failed or dropped
+#define MONITOR_RETRY_MS 5000
+#define MONITOR_TASK_CORE 0
+#define MONITOR_TASK_STACK 6144
+
+/**
+ * The value of a key that was updated, as delivered by a notification.
+ */
+struct MonitorNotification {
+    char value[MONITOR_VALUE_MAX];
+};
+
+/**
+ * A helper class AtMonitor runs a task (pinned to the network core on ESP32,
+ * a std::thread on the native build) that opens a MonitorTransport and reads
+ * notifications for one key. Each update is queued for the main loop and
+ * on_notify is called so the main loop can be told with an event. When the
+ * connection fails connected() is false and it is retried every
+ * MONITOR_RETRY_MS, so the caller can fall back to polling in the meantime.
+ *
+ * When built with SIM_DETERMINISTIC there is no thread, the host simulator
+ * steps the monitor with hal_sim::run_tasks() and it only reads the lines
+ * that are already waiting, retrying after MONITOR_RETRY_MS of virtual time.
+ */
+class AtMonitor {
+    MonitorTransport* transport;
+    const char* regex;
+    void (*on_notify)();
+
+    EventRing<MonitorNotification, MONITOR_QUEUE_SIZE> notifications;
+
+    std::atomic<bool> is_connected;
+    std::atomic<bool> running;
+    std::atomic<uint32_t> received;
+    std::atomic<uint32_t> dropped;
+    std::atomic<uint32_t> connects;
+
+#ifdef ARDUINO
+    TaskHandle_t task;
+    static void task_entry(void* self);
+#elif defined(SIM_DETERMINISTIC)
+    unsigned long retry_at;
+    static void step(void* self);
+#else
+    std::thread thread;
+    std::mutex lock;
+    std::condition_variable wake;
+#endif
+
+    void run();
+    void retry_delay();
+    void handle_line(const char* line);
+
+public:
+    AtMonitor();
+
+    /**
+     * Description: Destructor for AtMonitor, it does not touch the transport,
+     * which it does not own and which may be gone by then.
+     * Pre: stop() was called if the task can be blocked on the transport.
+     * Post: The task has finished.
+     */
+    ~AtMonitor();
+
+    /**
+     * Description: Start monitoring the keys matching regex.
+     * Pre: on_notify is safe to call from the monitor task.
+     * Post: Does nothing and connected() stays false if transport is nullptr.
+     */
+    void start(MonitorTransport* transport, const char* regex, void (*on_notify)());
+
+    /**
+     * Description: Stop the monitor task, the host programs call it before
+     * they exit. Does nothing on the ESP32.
+     * Pre: None
+     * Post: The connection is closed and the task has finished.
+     */
+    void stop();
+
+    /**
+     * Description: Checks if notifications are currently being received.
+     * Pre: None
+     * Post: Returns false while there is no open monitor connection.
+     */
+    bool connected() const;
+
+    /**
+     * Description: Take the oldest notification. Main loop only.
+     * Pre: None
+     * Post: Returns false if no notification is waiting.
+     */
+    bool take_notification(MonitorNotification& notification);
+
+    /**
+     * Description: Counters of notifications received and dropped (queue
+     * full or too long) and of monitor connections opened.
+     * Pre: None
+     * Post: Returns the count since boot.
+     */
+    uint32_t received_count() const;
+    uint32_t dropped_count() const;
+    uint32_t connect_count() const;
+
+    /**
+     * Description: Read the value of a notification line for a key matching
+     * regex, unescaping JSON string escapes.
+     * Pre: None
+     * Post: Returns false if the line is not a notification for a matching key
+     * or the value does not fit in size.
+     */
+    static bool parse(const char* line, const char* regex, char* value, size_t size);
+};
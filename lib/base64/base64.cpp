@@ -0,0 +1,71 @@
+/**
+ * Author: Malav Patel
+ * Description: Purpose of this file is to implement the base64 encoding
+ * defined in base64.h
+ */
+#include "base64.h"
+
+static const char BASE64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static int base64_value(char c)
+{
+    if (c >= 'A' && c <= 'Z') {
+        return c - 'A';
+    }
+    if (c >= 'a' && c <= 'z') {
+        return c - 'a' + 26;
+    }
+    if (c >= '0' && c <= '9') {
+        return c - '0' + 52;
+    }
+    if (c == '+') {
+        return 62;
+    }
+    if (c == '/') {
+        return 63;
+    }
+    return -1;
+}
+
+size_t base64_encode(const uint8_t* bytes, size_t length, char* text, size_t size)
+{
+    if (base64_length(length) + 1 > size) {
+        return 0;
+    }
+
+    size_t written = 0;
+    for (size_t i = 0; i < length; i += 3) {
+        uint32_t bits = (uint32_t)bytes[i] << 16;
+        bits |= i + 1 < length ? (uint32_t)bytes[i + 1] << 8 : 0;
+        bits |= i + 2 < length ? bytes[i + 2] : 0;
+        text[written++] = BASE64[(bits >> 18) & 63];
+        text[written++] = BASE64[(bits >> 12) & 63];
+        text[written++] = i + 1 < length ? BASE64[(bits >> 6) & 63] : '=';
+        text[written++] = i + 2 < length ? BASE64[bits & 63] : '=';
+    }
+    text[written] = '\0';
+    return written;
+}
+
+int base64_decode(const char* text, uint8_t* bytes, size_t size)
+{
+    size_t length = 0;
+    uint32_t bits = 0;
+    int count = 0;
+    for (; *text != '\0' && *text != '='; text++) {
+        int value = base64_value(*text);
+        if (value < 0) {
+            return -1;
+        }
+        bits = (bits << 6) | (uint32_t)value;
+        count += 6;
+        if (count >= 8) {
+            count -= 8;
+            if (length >= size) {
+                return -1;
+            }
+            bytes[length++] = (uint8_t)(bits >> count);
+        }
+    }
+    return (int)length;
+}
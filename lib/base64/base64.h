@@ -0,0 +1,38 @@
+/**
+ * Author: Malav Patel
+ * Description: Purpose of this file is to define the base64 encoding shared
+ * by the values the device and the client Application exchange, the AppBatch
+ * commands and the CycleLog uploads, so both use the same alphabet and
+ * padding.
+ */
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Description: Length of the base64 text of length bytes.
+ * Pre: None
+ * Post: Returns four characters for every three bytes started, without the
+ * null terminator.
+ */
+inline size_t base64_length(size_t length)
+{
+    return (length + 2) / 3 * 4;
+}
+
+/**
+ * Description: Encode bytes as base64 with the standard alphabet, padded
+ * with '='.
+ * Pre: None
+ * Post: Returns the length written to text without the null terminator, or
+ * 0 with nothing written if it does not fit in size.
+ */
+size_t base64_encode(const uint8_t* bytes, size_t length, char* text, size_t size);
+
+/**
+ * Description: Decode base64 text up to its end or the first '='.
+ * Pre: text is a null terminated string.
+ * Post: Returns the number of bytes decoded, or -1 if text has a character
+ * that is not base64 or does not fit in size.
+ */
+int base64_decode(const char* text, uint8_t* bytes, size_t size);
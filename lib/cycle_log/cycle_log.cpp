@@ -0,0 +1,404 @@
+/**
+ * Author: Malav Patel
+ * Description: Purpose of this file is to implement the
+ * CycleLog Class defined in cycle_log.h
+ */
+#include "cycle_log.h"
+
+#include <climits>
+#include <cstring>
+
+#include "base64.h"
+#include "hal.h"
+
+static_assert((CYCLE_LOG_BYTES & (CYCLE_LOG_BYTES - 1)) == 0, "CYCLE_LOG_BYTES must be a power of two");
+
+// Name of the checkpoint in flash
+static const char RECORD_NAME[] = "cycles";
+// Longest upload that is encoded or decoded, in bytes before base64
+static const size_t FRAME_MAX = 64;
+
+/**
+ * The checkpoint in flash, followed by the bytes of the records from the
+ * oldest one on.
+ */
+struct CycleLogRecord {
+    uint8_t version;
+    uint8_t reserved;
+    uint16_t used;
+    uint32_t first;
+    uint32_t count;
+    uint32_t base_at;
+    uint32_t last_at;
+    uint32_t sent;
+    uint32_t checksum;
+};
+
+// FNV-1a over the header before the checksum and the bytes of the records
+static uint32_t checksum(const CycleLogRecord& record, const uint8_t* bytes)
+{
+    uint32_t hash = 2166136261u;
+    const uint8_t* header = (const uint8_t*)&record;
+    for (size_t i = 0; i < offsetof(CycleLogRecord, checksum); i++) {
+        hash = (hash ^ header[i]) * 16777619u;
+    }
+    for (size_t i = 0; i < record.used; i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static size_t put_varint(uint8_t* bytes, uint32_t value)
+{
+    size_t length = 0;
+    while (value >= 0x80) {
+        bytes[length++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    bytes[length++] = (uint8_t)value;
+    return length;
+}
+
+// Returns false if the varint does not end before length
+static bool get_varint(const uint8_t* bytes, size_t length, size_t& at, uint32_t& value)
+{
+    value = 0;
+    for (int shift = 0; shift < 35 && at < length; shift += 7) {
+        uint8_t byte = bytes[at++];
+        value |= (uint32_t)(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static uint32_t zigzag(uint32_t delta)
+{
+    return (delta << 1) ^ (uint32_t)-(int32_t)(delta >> 31);
+}
+
+static uint32_t unzigzag(uint32_t value)
+{
+    return (value >> 1) ^ (uint32_t)-(int32_t)(value & 1);
+}
+
+// Encodes a record with its start time against previous_at
+static size_t encode_record(const DoorCycle& cycle, uint32_t previous_at, uint8_t* bytes)
+{
+    size_t length = 0;
+    bytes[length++] = (uint8_t)((cycle.door & 3) | (cycle.source & 3) << 2 | (cycle.opening ? 1 : 0) << 4 | (cycle.end & 7) << 5);
+    length += put_varint(bytes + length, zigzag(cycle.started_at - previous_at));
+    length += put_varint(bytes + length, cycle.duration_ms);
+    length += put_varint(bytes + length, cycle.latency_us);
+    return length;
+}
+
+// Decodes a record whose start time is taken against previous_at
+static bool decode_record(const uint8_t* bytes, size_t length, size_t& at, uint32_t previous_at, DoorCycle& cycle)
+{
+    if (at >= length) {
+        return false;
+    }
+    uint8_t header = bytes[at++];
+    uint32_t delta;
+    if (!get_varint(bytes, length, at, delta) || !get_varint(bytes, length, at, cycle.duration_ms)
+        || !get_varint(bytes, length, at, cycle.latency_us)) {
+        return false;
+    }
+    cycle.door = header & 3;
+    cycle.source = (header >> 2) & 3;
+    cycle.opening = (header >> 4) & 1;
+    cycle.end = (DoorCycleEnd)(header >> 5);
+    cycle.started_at = previous_at + unzigzag(delta);
+    return true;
+}
+
+CycleLog::CycleLog()
+    : head(0)
+    , used(0)
+    , first(0)
+    , count(0)
+    , base_at(0)
+    , last_at(0)
+    , sent(0)
+    , taken(0)
+    , unsent_since(0)
+    , changed(false)
+    , last_save(0)
+    , recorded(0)
+    , dropped(0)
+    , uploads(0)
+    , saves(0)
+{
+}
+
+uint8_t CycleLog::at(size_t offset) const
+{
+    return bytes[(head + offset) & (CYCLE_LOG_BYTES - 1)];
+}
+
+// Decodes the record at offset from the oldest one, whose start time is
+// taken against previous_at, and returns its size
+size_t CycleLog::read(size_t offset, uint32_t previous_at, DoorCycle& cycle) const
+{
+    uint8_t record[CYCLE_RECORD_MAX];
+    size_t length = used - offset < CYCLE_RECORD_MAX ? used - offset : CYCLE_RECORD_MAX;
+    for (size_t i = 0; i < length; i++) {
+        record[i] = at(offset + i);
+    }
+    size_t next = 0;
+    decode_record(record, length, next, previous_at, cycle);
+    return next;
+}
+
+void CycleLog::drop_oldest()
+{
+    DoorCycle cycle;
+    size_t size = read(0, base_at, cycle);
+    base_at = cycle.started_at;
+    head = (head + size) & (CYCLE_LOG_BYTES - 1);
+    used -= size;
+    if (sent == first) {
+        dropped++;
+        sent++;
+    }
+    if (taken == first) {
+        taken++;
+    }
+    first++;
+    count--;
+}
+
+void CycleLog::add(const DoorCycle& cycle, unsigned long now)
+{
+    uint8_t record[CYCLE_RECORD_MAX];
+    size_t size = encode_record(cycle, last_at, record);
+
+    // The delta of the new oldest record is against the one dropped before it
+    while (used + size > CYCLE_LOG_BYTES) {
+        drop_oldest();
+    }
+    if (unsent() == 0) {
+        unsent_since = now;
+    }
+
+    for (size_t i = 0; i < size; i++) {
+        bytes[(head + used + i) & (CYCLE_LOG_BYTES - 1)] = record[i];
+    }
+    used += size;
+    last_at = cycle.started_at;
+    count++;
+    recorded++;
+    changed = true;
+}
+
+uint32_t CycleLog::size() const
+{
+    return count;
+}
+
+uint32_t CycleLog::unsent() const
+{
+    return first + count - sent;
+}
+
+size_t CycleLog::bytes_used() const
+{
+    return used;
+}
+
+unsigned long CycleLog::upload_in(unsigned long now, unsigned long interval) const
+{
+    if (unsent() == 0 || uploading()) {
+        return ULONG_MAX;
+    }
+    if (unsent() >= CYCLE_UPLOAD_RECORDS) {
+        return 0;
+    }
+    unsigned long since = now - unsent_since;
+    return since >= interval ? 0 : interval - since;
+}
+
+uint32_t CycleLog::take_upload(char* text, size_t size)
+{
+    // The marker and four characters for every three bytes must fit
+    size_t frame_max = size < 3 ? 0 : (size - 2) / 4 * 3;
+    if (frame_max > FRAME_MAX) {
+        frame_max = FRAME_MAX;
+    }
+
+    uint8_t frame[FRAME_MAX + CYCLE_RECORD_MAX];
+    size_t length = 0;
+    frame[length++] = CYCLE_LOG_VERSION;
+    length += put_varint(frame + length, sent);
+
+    // Find the first record that was not uploaded and its start time
+    size_t offset = 0;
+    uint32_t previous_at = base_at;
+    for (uint32_t number = first; number < sent; number++) {
+        DoorCycle cycle;
+        offset += read(offset, previous_at, cycle);
+        previous_at = cycle.started_at;
+    }
+
+    uint32_t records = 0;
+    uint32_t frame_at = 0;
+    while (sent + records < first + count) {
+        DoorCycle cycle;
+        size_t record_length = read(offset, previous_at, cycle);
+
+        // Re-encoded against the record before it in the upload
+        size_t encoded = encode_record(cycle, frame_at, frame + length);
+        if (length + encoded > frame_max) {
+            break;
+        }
+        length += encoded;
+        frame_at = cycle.started_at;
+        previous_at = cycle.started_at;
+        offset += record_length;
+        records++;
+    }
+    if (records == 0) {
+        return 0;
+    }
+
+    text[0] = CYCLE_LOG_MARKER;
+    base64_encode(frame, length, text + 1, size - 1);
+
+    taken = sent + records;
+    return records;
+}
+
+bool CycleLog::uploading() const
+{
+    return taken != sent;
+}
+
+void CycleLog::uploaded()
+{
+    if (!uploading()) {
+        return;
+    }
+    sent = taken;
+    uploads++;
+    changed = true;
+}
+
+size_t CycleLog::decode(const char* text, uint32_t& first, DoorCycle* cycles, size_t max)
+{
+    if (text[0] != CYCLE_LOG_MARKER) {
+        return 0;
+    }
+
+    uint8_t frame[FRAME_MAX];
+    int decoded = base64_decode(text + 1, frame, sizeof(frame));
+    if (decoded < 1) {
+        return 0;
+    }
+    size_t length = (size_t)decoded;
+
+    size_t at = 1;
+    if ( frame[0] != CYCLE_LOG_VERSION || !get_varint(frame, length, at, first)) {
+        return 0;
+    }
+    size_t records = 0;
+    uint32_t previous_at = 0;
+    while (records < max && at < length && decode_record(frame, length, at, previous_at, cycles[records])) {
+        previous_at = cycles[records].started_at;
+        records++;
+    }
+    return records;
+}
+
+bool CycleLog::load()
+{
+    uint8_t data[sizeof(CycleLogRecord) + CYCLE_LOG_BYTES];
+    size_t size = flash_size(RECORD_NAME);
+    if (size < sizeof(CycleLogRecord) || size > sizeof(data) || !flash_read(RECORD_NAME, data, size)) {
+        return false;
+    }
+
+    CycleLogRecord record;
+    memcpy(&record, data, sizeof(record));
+    const uint8_t* records = data + sizeof(record);
+    if (record.version != CYCLE_LOG_VERSION || sizeof(record) + record.used != size
+        || record.checksum != checksum(record, records) || record.sent - record.first > record.count) {
+        return false;
+    }
+
+    memcpy(bytes, records, record.used);
+    head = 0;
+    used = record.used;
+    first = record.first;
+    count = record.count;
+    base_at = record.base_at;
+    last_at = record.last_at;
+    sent = record.sent;
+    taken = record.sent;
+    unsent_since = 0;
+    changed = false;
+    return true;
+}
+
+unsigned long CycleLog::save_in(unsigned long now, unsigned long interval) const
+{
+    if (!changed) {
+        return ULONG_MAX;
+    }
+    unsigned long since = now - last_save;
+    return since >= interval ? 0 : interval - since;
+}
+
+bool CycleLog::save(unsigned long now)
+{
+    if (!changed) {
+        return false;
+    }
+    last_save = now;
+
+    uint8_t data[sizeof(CycleLogRecord) + CYCLE_LOG_BYTES];
+    CycleLogRecord record;
+    memset(&record, 0, sizeof(record));
+    record.version = CYCLE_LOG_VERSION;
+    record.used = (uint16_t)used;
+    record.first = first;
+    record.count = count;
+    record.base_at = base_at;
+    record.last_at = last_at;
+    record.sent = sent;
+
+    uint8_t* records = data + sizeof(record);
+    for (size_t i = 0; i < used; i++) {
+        records[i] = at(i);
+    }
+    record.checksum = checksum(record, records);
+    memcpy(data, &record, sizeof(record));
+    if (!flash_write(RECORD_NAME, data, sizeof(record) + used)) {
+        return false;
+    }
+
+    changed = false;
+    saves++;
+    return true;
+}
+
+uint32_t CycleLog::recorded_count() const
+{
+    return recorded;
+}
+
+uint32_t CycleLog::dropped_count() const
+{
+    return dropped;
+}
+
+uint32_t CycleLog::upload_count() const
+{
+    return uploads;
+}
+
+uint32_t CycleLog::save_count() const
+{
+    return saves;
+}
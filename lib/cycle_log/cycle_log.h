@@ -0,0 +1,209 @@
+/**
+ * Author: Malav Patel
+ * Description: Purpose of this file is to define a helper class CycleLog
+ * that keeps a history of how the doors moved, small enough to hold in RAM,
+ * checkpoint to flash and upload a few records at a time in one AtKey value.
+ */
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Bytes of encoded records the ring holds, a power of two. The oldest
+// records are dropped when a new one does not fit.
+#define CYCLE_LOG_BYTES 512
+// Longest encoded record: the header byte and three varints of 32 bits
+#define CYCLE_RECORD_MAX 16
+// Version of the upload and flash formats
+#define CYCLE_LOG_VERSION 1
+// First character of an upload
+#define CYCLE_LOG_MARKER '#'
+// Records that are uploaded right away instead of waiting for more
+#define CYCLE_UPLOAD_RECORDS 4
+
+/**
+ * How a cycle of a door ended.
+ */
+enum DoorCycleEnd : uint8_t {
+    // The door reached fully open or fully closed
+    cycle_opened = 0,
+    cycle_closed = 1,
+    // A halt stopped the door
+    cycle_halted = 2,
+    // A move to a position part way arrived
+    cycle_stopped = 3,
+    // Another command started a new cycle before this one ended
+    cycle_superseded = 4
+};
+
+/**
+ * One cycle of a door: a motion that opens or closes it, from the command
+ * that started it until the door stood still again.
+ */
+struct DoorCycle {
+    // Time of day the motion started, seconds since 1970, 0 if it was not known
+    uint32_t started_at;
+    // Milliseconds from the start of the motion until it ended
+    uint32_t duration_ms;
+    // Microseconds from the command being added to the EventBus until the
+    // motion started
+    uint32_t latency_us;
+    // Index of the door, 0 to 3
+    uint8_t door;
+    // The EventSource of the command, 0 to 3
+    uint8_t source;
+    bool opening;
+    DoorCycleEnd end;
+};
+
+/**
+ * A helper class CycleLog is a ring of DoorCycle records, delta encoded so a
+ * record takes about 7 bytes instead of the 16 of a DoorCycle. A record is a
+ * header byte (door in bits 0-1, source in bits 2-3, opening in bit 4 and the
+ * end in bits 5-7) followed by three LEB128 varints: the start time minus the
+ * start time of the record before it (zigzag encoded, the clock can be set
+ * back), the duration and the latency.
+ *
+ * Every record gets a number, counting from the first record the device ever
+ * kept. take_upload() encodes the oldest records that were not uploaded yet
+ * into one value, the marker followed by the base64 of:
+ *
+ *   version (1 byte), number of the first record (varint), records
+ *
+ * where the start time of the first record is taken against 0. The records
+ * of an upload are uploaded once uploaded() is called; until then the same
+ * records are taken again, so a write that is lost is sent again and the
+ * client Application drops records by number that it has seen.
+ *
+ * save() checkpoints the ring to flash only when it changed, load() carries
+ * it over a reboot. The ring is only used from the main loop.
+ */
+class CycleLog {
+    uint8_t bytes[CYCLE_LOG_BYTES];
+    // Offset of the oldest record and bytes in use
+    size_t head;
+    size_t used;
+    // Number of the oldest record and records held
+    uint32_t first;
+    uint32_t count;
+    // Start time of the record before the oldest one and of the newest one
+    uint32_t base_at;
+    uint32_t last_at;
+    // Number of the first record not uploaded and after the last one taken
+    uint32_t sent;
+    uint32_t taken;
+    // When the oldest record that was not uploaded was added
+    unsigned long unsent_since;
+
+    bool changed;
+    unsigned long last_save;
+
+    uint32_t recorded;
+    uint32_t dropped;
+    uint32_t uploads;
+    uint32_t saves;
+
+    uint8_t at(size_t offset) const;
+    size_t read(size_t offset, uint32_t previous_at, DoorCycle& cycle) const;
+    void drop_oldest();
+
+public:
+    CycleLog();
+
+    /**
+     * Description: Add the record of a cycle that ended.
+     * Pre: cycle.door < 4 and cycle.source < 4.
+     * Post: The record is the newest, the oldest records are dropped if it
+     * did not fit and counted if they were not uploaded yet.
+     */
+    void add(const DoorCycle& cycle, unsigned long now);
+
+    /**
+     * Description: Records held, and records of them not uploaded yet.
+     * Pre: None
+     * Post: Returns the count.
+     */
+    uint32_t size() const;
+    uint32_t unsent() const;
+
+    /**
+     * Description: Bytes the records held take in the ring.
+     * Pre: None
+     * Post: Returns at most CYCLE_LOG_BYTES.
+     */
+    size_t bytes_used() const;
+
+    /**
+     * Description: Time until an upload is due, which is when
+     * CYCLE_UPLOAD_RECORDS are waiting or the oldest waiting record was added
+     * interval ms ago.
+     * Pre: None
+     * Post: Returns milliseconds, 0 if an upload is due and ULONG_MAX if no
+     * record is waiting or an upload is not done yet.
+     */
+    unsigned long upload_in(unsigned long now, unsigned long interval) const;
+
+    /**
+     * Description: Encode the oldest records that were not uploaded, as many
+     * as fit in size.
+     * Pre: None
+     * Post: Returns the number of records in text, 0 if there are none, and
+     * marks them as taken.
+     */
+    uint32_t take_upload(char* text, size_t size);
+
+    /**
+     * Description: Checks if records were taken that are not uploaded yet.
+     * Pre: None
+     * Post: Returns true between take_upload() and uploaded().
+     */
+    bool uploading() const;
+
+    /**
+     * Description: Mark the records of the last take_upload() as uploaded.
+     * Pre: The value was acknowledged by the server.
+     * Post: The next upload starts after them.
+     */
+    void uploaded();
+
+    /**
+     * Description: Decode an upload, as the client Application would.
+     * Pre: text is a null terminated string.
+     * Post: Returns the number of records written to cycles, at most max,
+     * and sets first to the number of the first one. Returns 0 if text is
+     * not an upload.
+     */
+    static size_t decode(const char* text, uint32_t& first, DoorCycle* cycles, size_t max);
+
+    /**
+     * Description: Read the checkpoint from flash.
+     * Pre: None
+     * Post: Returns true and replaces the ring if a valid checkpoint was found.
+     */
+    bool load();
+
+    /**
+     * Description: Time until a checkpoint on the cadence is due.
+     * Pre: None
+     * Post: Returns milliseconds, 0 if it is due and ULONG_MAX if nothing
+     * changed since the last one.
+     */
+    unsigned long save_in(unsigned long now, unsigned long interval) const;
+
+    /**
+     * Description: Write the checkpoint to flash if the ring changed.
+     * Pre: None
+     * Post: Returns true if a record was written.
+     */
+    bool save(unsigned long now);
+
+    /**
+     * Description: Counters of records added, records dropped before they
+     * were uploaded, uploads acknowledged and checkpoints written.
+     * Pre: None
+     * Post: Returns the count since boot.
+     */
+    uint32_t recorded_count() const;
+    uint32_t dropped_count() const;
+    uint32_t upload_count() const;
+    uint32_t save_count() const;
+};
@@ -0,0 +1,107 @@
+/**
+ * Author: Malav Patel
+ * Description: Purpose of this file is to implement the
+ * DeviceStateStore Class defined in device_state.h
+ */
+#include "device_state.h"
+
+#include <climits>
+#include <cstring>
+
+#include "hal.h"
+
+// Name of the record in flash
+static const char RECORD_NAME[] = "state";
+
+/**
+ * The record in flash: the layout version, the snapshot and a checksum of
+ * both.
+ */
+struct DeviceStateRecord {
+    uint32_t version;
+    DeviceState state;
+    uint32_t checksum;
+};
+
+// FNV-1a over the version and the snapshot
+static uint32_t checksum(const DeviceStateRecord& record)
+{
+    const uint8_t* bytes = (const uint8_t*)&record;
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < offsetof(DeviceStateRecord, checksum); i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+DeviceStateStore::DeviceStateStore()
+    : has_saved(false)
+    , last_save(0)
+    , saves(0)
+    , unchanged(0)
+{
+    memset(&saved, 0, sizeof(saved));
+}
+
+bool DeviceStateStore::load(DeviceState& state)
+{
+    DeviceStateRecord record;
+    if (!flash_read(RECORD_NAME, &record, sizeof(record))) {
+        return false;
+    }
+    if (record.version != DEVICE_STATE_VERSION || record.checksum != checksum(record)) {
+        return false;
+    }
+
+    state = record.state;
+    saved = record.state;
+    has_saved = true;
+    return true;
+}
+
+bool DeviceStateStore::save_due(unsigned long now, unsigned long interval) const
+{
+    return now - last_save >= interval;
+}
+
+unsigned long DeviceStateStore::save_in(const DeviceState& state, unsigned long now, unsigned long interval) const
+{
+    if (has_saved && memcmp(&saved, &state, sizeof(state)) == 0) {
+        return ULONG_MAX;
+    }
+    unsigned long since = now - last_save;
+    return since >= interval ? 0 : interval - since;
+}
+
+bool DeviceStateStore::save(const DeviceState& state, unsigned long now)
+{
+    last_save = now;
+    if (has_saved && memcmp(&saved, &state, sizeof(state)) == 0) {
+        unchanged++;
+        return false;
+    }
+
+    DeviceStateRecord record;
+    memset(&record, 0, sizeof(record));
+    record.version = DEVICE_STATE_VERSION;
+    record.state = state;
+    record.checksum = checksum(record);
+    if (!flash_write(RECORD_NAME, &record, sizeof(record))) {
+        return false;
+    }
+
+    saved = state;
+    has_saved = true;
+    saves++;
+    return true;
+}
+
+uint32_t DeviceStateStore::save_count() const
+{
+    return saves;
+}
+
+uint32_t DeviceStateStore::unchanged_count() const
+{
+    return unchanged;
+}
@@ -0,0 +1,118 @@
+/**
+ * Author: Malav Patel
+ * Description: Purpose of this file is to define the snapshot of the state
+ * of the device that is kept in flash, so a reboot can carry on where the
+ * device was instead of starting from a closed door.
+ */
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Version of the snapshot layout, a snapshot of another version is ignored
+#define DEVICE_STATE_VERSION 2
+// Doors a snapshot has room for, the ones the device does not drive are zero
+#define DEVICE_STATE_DOORS 4
+
+/**
+ * Bits of DoorState::published and DeviceState::published, set for every
+ * value the server is known to have acknowledged.
+ */
+enum DevicePublished {
+    published_status = 1,
+    published_re = 2,
+    published_position = 4,
+    published_ack = 8
+};
+
+/**
+ * What one door needs to come back after a reboot: its status, servo angle
+ * and Rotary Encoder value, and the values of its AtKeys the server last
+ * acknowledged.
+ */
+struct DoorState {
+    uint8_t door_status;
+    uint8_t re_value;
+    uint8_t published;
+    uint8_t reserved;
+    int16_t servo_angle;
+    int16_t door_position;
+    int32_t published_status;
+    int32_t published_re;
+    int32_t published_position;
+};
+
+static_assert(sizeof(DoorState) == 20, "DoorState has padding");
+
+/**
+ * What the device needs to come back after a reboot: every door, the last
+ * command of the client Application that was applied and the
+ * acknowledgement the server last had for it. Every field has a fixed size
+ * and there is no padding, so two snapshots can be compared byte for byte.
+ */
+struct DeviceState {
+    uint8_t app_sequence_known;
+    uint8_t published;
+    uint16_t app_sequence;
+    int32_t published_ack;
+    DoorState doors[DEVICE_STATE_DOORS];
+};
+
+static_assert(sizeof(DeviceState) == 8 + 20 * DEVICE_STATE_DOORS, "DeviceState has padding");
+
+/**
+ * A helper class DeviceStateStore reads the snapshot at boot and writes it
+ * back when it changed. The record in flash carries the layout version and a
+ * checksum, a record that is torn, of another version or of another size is
+ * treated as no snapshot at all. Writes are limited to one per save interval
+ * and skipped when nothing changed, to spare the flash.
+ */
+class DeviceStateStore {
+    DeviceState saved;
+    bool has_saved;
+    unsigned long last_save;
+
+    uint32_t saves;
+    uint32_t unchanged;
+
+public:
+    DeviceStateStore();
+
+    /**
+     * Description: Read the snapshot from flash.
+     * Pre: None
+     * Post: Returns true and fills state if a valid snapshot was found.
+     */
+    bool load(DeviceState& state);
+
+    /**
+     * Description: Checks if a save is due on the cadence.
+     * Pre: None
+     * Post: Returns true if interval ms have passed since the last save.
+     */
+    bool save_due(unsigned long now, unsigned long interval) const;
+
+    /**
+     * Description: Time until a save on the cadence would write a snapshot.
+     * Pre: state was zeroed before it was filled in.
+     * Post: Returns milliseconds, 0 if a save is due already and ULONG_MAX
+     * if state is the one written last.
+     */
+    unsigned long save_in(const DeviceState& state, unsigned long now, unsigned long interval) const;
+
+    /**
+     * Description: Write the snapshot to flash unless it is the one that was
+     * written last.
+     * Pre: state was zeroed before it was filled in.
+     * Post: Returns true if a record was written.
+     */
+    bool save(const DeviceState& state, unsigned long now);
+
+    /**
+     * Description: Counters of snapshots written and of saves skipped because
+     * nothing changed.
+     * Pre: None
+     * Post: Returns the count since boot.
+     */
+    uint32_t save_count() const;
+    uint32_t unchanged_count() const;
+};
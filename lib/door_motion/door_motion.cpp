@@ -0,0 +1,121 @@
+/**
+ * Author: Malav Patel
+ * Description: Purpose of this file is to implement the
+ * DoorMotion Class defined in door_motion.h
+ */
+#include "door_motion.h"
+
+#include <climits>
+
+DoorMotion::DoorMotion(int angle, int min_angle, int max_angle, unsigned long ms_per_degree)
+    : angle(angle)
+    , target(angle)
+    , min_angle(min_angle)
+    , max_angle(max_angle)
+    , ms_per_degree(ms_per_degree == 0 ? 1 : ms_per_degree)
+    , last_step(0)
+    , moving(false)
+    , halt_latency_last(0)
+    , halt_latency_max(0)
+{
+}
+
+void DoorMotion::move_to(int target_angle, unsigned long now)
+{
+    if (target_angle < min_angle) {
+        target_angle = min_angle;
+    } else if (target_angle > max_angle) {
+        target_angle = max_angle;
+    }
+
+    if (!moving) {
+        last_step = now;
+    }
+    target = target_angle;
+    moving = target != angle;
+}
+
+void DoorMotion::move_by(int delta, unsigned long now)
+{
+    move_to((moving ? target : angle) + delta, now);
+}
+
+void DoorMotion::halt(unsigned long requested_at, unsigned long now)
+{
+    target = angle;
+    moving = false;
+
+    halt_latency_last = now - requested_at;
+    if (halt_latency_last > halt_latency_max) {
+        halt_latency_max = halt_latency_last;
+    }
+}
+
+void DoorMotion::reset(int at_angle)
+{
+    if (at_angle < min_angle) {
+        at_angle = min_angle;
+    } else if (at_angle > max_angle) {
+        at_angle = max_angle;
+    }
+    angle = at_angle;
+    target = at_angle;
+    moving = false;
+}
+
+DoorMotion::TickResult DoorMotion::tick(unsigned long now)
+{
+    if (!moving) {
+        return TickResult::idle;
+    }
+
+    unsigned long due = (now - last_step) / ms_per_degree;
+    if (due == 0) {
+        return TickResult::idle;
+    }
+    last_step += due * ms_per_degree;
+
+    int remaining = target > angle ? target - angle : angle - target;
+    int degrees = due < (unsigned long)remaining ? (int)due : remaining;
+    angle += target > angle ? degrees : -degrees;
+
+    if (angle == target) {
+        moving = false;
+        return TickResult::arrived;
+    }
+    return TickResult::stepped;
+}
+
+int DoorMotion::current_angle() const
+{
+    return angle;
+}
+
+int DoorMotion::target_angle() const
+{
+    return target;
+}
+
+bool DoorMotion::is_moving() const
+{
+    return moving;
+}
+
+unsigned long DoorMotion::next_step_in(unsigned long now) const
+{
+    if (!moving) {
+        return ULONG_MAX;
+    }
+    unsigned long since = now - last_step;
+    return since >= ms_per_degree ? 0 : ms_per_degree - since;
+}
+
+unsigned long DoorMotion::last_halt_latency() const
+{
+    return halt_latency_last;
+}
+
+unsigned long DoorMotion::max_halt_latency() const
+{
+    return halt_latency_max;
+}
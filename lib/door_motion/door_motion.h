@@ -0,0 +1,102 @@
+/**
+ * Author: Malav Patel
+ * Description: Purpose of this file is to define a helper class
+ * DoorMotion that moves the door servo towards a target angle without
+ * blocking the main loop.
+ */
+#pragma once
+
+/**
+ * A helper class DoorMotion keeps the current and target angle of the servo
+ * and advances the current angle by one degree every ms_per_degree
+ * milliseconds when tick() is called from the main loop. Nothing in the class
+ * blocks, so the main loop keeps handling events while the door is moving and
+ * a halt takes effect on the next tick.
+ */
+class DoorMotion {
+    int angle;
+    int target;
+    int min_angle;
+    int max_angle;
+    unsigned long ms_per_degree;
+    unsigned long last_step;
+    bool moving;
+
+    unsigned long halt_latency_last;
+    unsigned long halt_latency_max;
+
+public:
+    /**
+     * Result of a call to tick().
+     */
+    enum TickResult {
+        // The door is not moving or it is not time for the next degree yet
+        idle,
+        // The angle changed and the door is still moving
+        stepped,
+        // The angle changed and the door has reached the target
+        arrived
+    };
+
+    DoorMotion(int angle, int min_angle, int max_angle, unsigned long ms_per_degree);
+
+    /**
+     * Description: Start moving the door towards an absolute angle.
+     * Pre: None
+     * Post: The target is set, clamped to the servo range. The door starts
+     * moving on the next tick.
+     */
+    void move_to(int target_angle, unsigned long now);
+
+    /**
+     * Description: Move the target of the door by a relative amount of degrees.
+     * Pre: None
+     * Post: The target is moved from the current target (or from the current
+     * angle when idle), clamped to the servo range.
+     */
+    void move_by(int delta, unsigned long now);
+
+    /**
+     * Description: Stop the door where it is.
+     * Pre: requested_at is the millis() at which the halt was requested.
+     * Post: The target is the current angle and the door is no longer moving.
+     * The time from request to stop is recorded.
+     */
+    void halt(unsigned long requested_at, unsigned long now);
+
+    /**
+     * Description: Place the door at an angle without moving it, for an angle
+     * restored at boot.
+     * Pre: None
+     * Post: The angle and target are set, clamped to the servo range, and the
+     * door is not moving.
+     */
+    void reset(int at_angle);
+
+    /**
+     * Description: Advance the door towards the target by the degrees that are due.
+     * Pre: Called on every iteration of the main loop.
+     * Post: Returns if the angle changed and if the door reached the target.
+     */
+    TickResult tick(unsigned long now);
+
+    int current_angle() const;
+    int target_angle() const;
+    bool is_moving() const;
+
+    /**
+     * Description: Time until tick() moves the door by the next degree.
+     * Pre: None
+     * Post: Returns milliseconds, 0 if a degree is due already and ULONG_MAX
+     * if the door is not moving.
+     */
+    unsigned long next_step_in(unsigned long now) const;
+
+    /**
+     * Description: Time from the halt request to the door being stopped.
+     * Pre: None
+     * Post: Returns the last and the worst halt latency in milliseconds.
+     */
+    unsigned long last_halt_latency() const;
+    unsigned long max_halt_latency() const;
+};
@@ -6,51 +6,536 @@
  *
  */
 #pragma once
-#include <queue>
-#include <string>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
 
 /**
- * A helper class EventBus uses a deque underneath
- * to create an EventBus that manages to events that have occured or need to be
- * handled by the code when the main loop is busy performing action.
+ * A fixed capacity ring of events that can be pushed to from any number of
+ * producers (interrupt handlers and the main loop) and drained by a single
+ * consumer (the main loop). The ring never allocates and never blocks, a push
+ * on a full ring fails and is counted instead.
+ *
+ * The implementation is the bounded queue described by Dmitry Vyukov, every
+ * cell carries a sequence number that tells producers and the consumer if the
+ * cell is free to write or ready to read.
+ */
+template <typename T, size_t N>
+class EventRing {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "EventRing capacity must be a power of two");
+
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    Cell cells[N];
+    std::atomic<size_t> enqueue_pos;
+    size_t dequeue_pos;
+
+public:
+    EventRing()
+        : enqueue_pos(0)
+        , dequeue_pos(0)
+    {
+        for (size_t i = 0; i < N; i++) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * Description: Push a value at the back of the ring, safe from interrupts.
+     * Pre: None
+     * Post: Returns false without modifying the ring if it is full.
+     */
+    bool push(const T& value)
+    {
+        size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+            cell = &cells[pos & (N - 1)];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+            if (diff == 0) {
+                if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value = value;
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Description: Look at the oldest value without removing it. Consumer only.
+     * Pre: None
+     * Post: Returns nullptr if no completed value is available.
+     */
+    const T* peek() const
+    {
+        const Cell& cell = cells[dequeue_pos & (N - 1)];
+        if (cell.sequence.load(std::memory_order_acquire) != dequeue_pos + 1) {
+            return nullptr;
+        }
+        return &cell.value;
+    }
+
+    /**
+     * Description: Remove the oldest value. Consumer only.
+     * Pre: peek() returned a value.
+     * Post: The cell is released back to the producers.
+     */
+    void pop()
+    {
+        Cell& cell = cells[dequeue_pos & (N - 1)];
+        cell.sequence.store(dequeue_pos + N, std::memory_order_release);
+        dequeue_pos++;
+    }
+
+    /**
+     * Description: Number of values pushed but not yet popped.
+     * Pre: None
+     * Post: The result is a snapshot and may be stale when producers are active.
+     */
+    size_t size() const
+    {
+        return enqueue_pos.load(std::memory_order_acquire) - dequeue_pos;
+    }
+};
+
+/**
+ * Maps an event to the index used by EventBus to keep per kind bookkeeping.
+ * Enum events map to their numeric value, other event types can provide an
+ * overload found by argument dependent lookup.
  */
 template <typename T>
+inline size_t event_kind(const T& e)
+{
+    return static_cast<size_t>(e);
+}
+
+/**
+ * Maps an event to the correlation ID it was added with, 0 for none. Event
+ * types that carry one provide an overload found by argument dependent lookup.
+ */
+template <typename T>
+inline size_t event_correlation(const T& e)
+{
+    (void)e;
+    return 0;
+}
+
+/**
+ * A helper class EventBus uses fixed size rings underneath, one per priority
+ * level, to create an EventBus that manages to events that have occured or
+ * need to be handled by the code when the main loop is busy performing action.
+ *
+ * Every kind of event is given a level with set_priority(), level 0 is the
+ * most urgent. The oldest event of the most urgent level that is not empty is
+ * handled first, events of one level are handled in the order they were
+ * added. Events added with sos() always go into level 0. Both add() and sos()
+ * are safe to call from interrupt handlers, nothing is allocated after
+ * construction.
+ *
+ * Every pending event of a level, or every pending event added with a
+ * correlation ID, can be cancelled at once. A cancel only moves a generation
+ * counter, so it costs the same no matter how many events are waiting. The
+ * cancelled events are skipped when they reach the front of their level.
+ * With PARTITIONS above 1 every event also belongs to the partition
+ * event_partition() returns for it, for example the door it is about, and a
+ * level can be cancelled for one partition while the others keep theirs.
+ *
+ * Kinds of events that only read the current state when handled (syncing a
+ * value, redrawing the display) can be marked idempotent. Adding one while an
+ * identical one is still pending folds it into the pending entry instead of
+ * queueing it again. Idempotent kinds that draw over each other can share a
+ * group, a kind is then only folded when it was also the last one of its group
+ * to be added so the last requested one is still handled last.
+ *
+ * When a clock is set every event is stamped with the time it was added, so
+ * the time it waited on the bus can be measured once it is handled.
+ */
+template <typename T, size_t N = 64, size_t SOS_N = 8, size_t KINDS = 32, size_t LEVELS = 4, size_t CORRELATIONS = 16, size_t PARTITIONS = 1>
 class EventBus {
-    deque<T> events;
+    static_assert(LEVELS >= 2 && LEVELS <= 255, "EventBus needs a level for sos() and at least one other");
+    static_assert(PARTITIONS >= 1, "EventBus needs at least one partition");
+
+    static const size_t NO_GROUP = KINDS;
+
+    struct Stamped {
+        T value;
+        uint32_t added_at;
+        uint16_t level_generation;
+        uint16_t correlation_generation;
+    };
+
+    EventRing<Stamped, SOS_N> sos_events;
+    EventRing<Stamped, N> events[LEVELS - 1];
+    std::atomic<uint32_t> overflows;
+    std::atomic<uint32_t> cancelled;
+    std::atomic<size_t> high_water;
+    unsigned long (*clock)();
+
+    std::atomic<uint16_t> pending[KINDS];
+    std::atomic<uint32_t> coalesced[KINDS];
+    size_t group_of[KINDS];
+    std::atomic<size_t> last_in_group[KINDS];
+    uint8_t level_of[KINDS];
+
+    std::atomic<uint16_t> level_generation[PARTITIONS][LEVELS];
+    std::atomic<uint16_t> correlation_generation[CORRELATIONS];
+
+    // Without partitions T does not need an event_partition()
+    static size_t partition_of(const T& e)
+    {
+        if constexpr (PARTITIONS > 1) {
+            size_t partition = event_partition(e);
+            return partition < PARTITIONS ? partition : 0;
+        } else {
+            (void)e;
+            return 0;
+        }
+    }
+
+    // Counted before the push so the consumer never sees an event
+    // that is not counted as pending yet
+    void track_added(size_t kind)
+    {
+        if (kind < KINDS) {
+            pending[kind].fetch_add(1, std::memory_order_acq_rel);
+            if (group_of[kind] != NO_GROUP) {
+                last_in_group[group_of[kind]].store(kind, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void track_removed(size_t kind)
+    {
+        if (kind < KINDS) {
+            pending[kind].fetch_sub(1, std::memory_order_acq_rel);
+        }
+    }
+
+    Stamped stamp(const T& e, size_t level) const
+    {
+        Stamped stamped;
+        stamped.value = e;
+        stamped.added_at = clock == nullptr ? 0 : (uint32_t)clock();
+        stamped.level_generation = level_generation[partition_of(e)][level].load(std::memory_order_acquire);
+        size_t correlation = event_correlation(e);
+        stamped.correlation_generation = correlation < CORRELATIONS
+            ? correlation_generation[correlation].load(std::memory_order_acquire)
+            : 0;
+        return stamped;
+    }
+
+    bool is_cancelled(const Stamped& e, size_t level) const
+    {
+        if (e.level_generation != level_generation[partition_of(e.value)][level].load(std::memory_order_acquire)) {
+            return true;
+        }
+        size_t correlation = event_correlation(e.value);
+        return correlation != 0 && correlation < CORRELATIONS
+            && e.correlation_generation != correlation_generation[correlation].load(std::memory_order_acquire);
+    }
+
+    bool push(const T& e, size_t level)
+    {
+        size_t kind = event_kind(e);
+        track_added(kind);
+        bool pushed = level == 0 ? sos_events.push(stamp(e, level)) : events[level - 1].push(stamp(e, level));
+        if (!pushed) {
+            track_removed(kind);
+            overflows.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        track_depth();
+        return true;
+    }
+
+    void track_depth()
+    {
+        size_t depth = size();
+        size_t seen = high_water.load(std::memory_order_relaxed);
+        while (depth > seen && !high_water.compare_exchange_weak(seen, depth, std::memory_order_relaxed)) {
+        }
+    }
+
+    const Stamped* peek(size_t level) const
+    {
+        return level == 0 ? sos_events.peek() : events[level - 1].peek();
+    }
+
+    void pop(size_t level)
+    {
+        size_t kind = event_kind(peek(level)->value);
+        if (level == 0) {
+            sos_events.pop();
+        } else {
+            events[level - 1].pop();
+        }
+        track_removed(kind);
+    }
+
+    // Consumer only, discards the cancelled events it finds at the front
+    const Stamped* front(size_t& level)
+    {
+        for (level = 0; level < LEVELS; level++) {
+            const Stamped* e;
+            while ((e = peek(level)) != nullptr && is_cancelled(*e, level)) {
+                pop(level);
+                cancelled.fetch_add(1, std::memory_order_relaxed);
+            }
+            if (e != nullptr) {
+                return e;
+            }
+        }
+        return nullptr;
+    }
 
 public:
+    EventBus()
+        : overflows(0)
+        , cancelled(0)
+        , high_water(0)
+        , clock(nullptr)
+    {
+        for (size_t i = 0; i < KINDS; i++) {
+            pending[i].store(0, std::memory_order_relaxed);
+            coalesced[i].store(0, std::memory_order_relaxed);
+            group_of[i] = NO_GROUP;
+            last_in_group[i].store(NO_GROUP, std::memory_order_relaxed);
+            level_of[i] = LEVELS - 1;
+        }
+        for (size_t p = 0; p < PARTITIONS; p++) {
+            for (size_t i = 0; i < LEVELS; i++) {
+                level_generation[p][i].store(0, std::memory_order_relaxed);
+            }
+        }
+        for (size_t i = 0; i < CORRELATIONS; i++) {
+            correlation_generation[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
     /**
-     * Description: Checks if EventBus is empty.
+     * Description: Checks if EventBus is empty. Main loop only.
      * Pre: None
-     * Post: Returns true if EventBus is empty.
+     * Post: Returns true if no event that was not cancelled is waiting.
      */
-    boolean empty();
+    bool empty()
+    {
+        size_t level;
+        return front(level) == nullptr;
+    }
 
     /**
      * Description: Return the current event that needs to be handled.
-     * Pre: None
-     * Post: Return Event that is first in EventBus.
+     * Pre: EventBus is not empty.
+     * Post: Return the oldest Event of the most urgent level.
+     */
+    T current()
+    {
+        size_t level;
+        const Stamped* e = front(level);
+        return e == nullptr ? T() : e->value;
+    }
+
+    /**
+     * Description: Return the time the current event was added at.
+     * Pre: EventBus is not empty and a clock was set.
+     * Post: Return the clock reading (truncated to 32 bits) from when the
+     * current event was added.
      */
-    Event current();
+    uint32_t current_added_at()
+    {
+        size_t level;
+        const Stamped* e = front(level);
+        return e == nullptr ? 0 : e->added_at;
+    }
 
     /**
-     * Description: Add an event that needs to be handled to EventBus.
+     * Description: Add an event that needs to be handled to EventBus, in the
+     * level set for its kind.
      * Pre: None
      * Post: An event that needs to be processed will be added to EventBus.
+     * Returns false and counts an overflow if its level is full.
      */
-    void add(T e);
+    bool add(T e)
+    {
+        size_t kind = event_kind(e);
+        if (kind < KINDS && group_of[kind] != NO_GROUP
+            && pending[kind].load(std::memory_order_acquire) > 0
+            && last_in_group[group_of[kind]].load(std::memory_order_relaxed) == kind) {
+            coalesced[kind].fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+        return push(e, kind < KINDS ? level_of[kind] : LEVELS - 1);
+    }
 
     /**
      * Description: Add an event that needs to be handled on first priority to EventBus.
      * Pre: None
-     * Post: An event that needs to be processed immediatly will be added to EventBus in the front.
+     * Post: An event that needs to be processed immediatly will be added to
+     * level 0 of EventBus whatever the level of its kind.
+     * Returns false and counts an overflow if level 0 is full.
      */
-    void sos(T e);
+    bool sos(T e)
+    {
+        return push(e, 0);
+    }
 
     /**
      * Description: Mark the current event as completed and remove from the event bus.
      * Pre: None
-     * Post: The first event from the event bus will be removed.
+     * Post: The current event will be removed from the event bus.
+     */
+    void current_completed()
+    {
+        size_t level;
+        if (front(level) != nullptr) {
+            pop(level);
+        }
+    }
+
+    /**
+     * Description: Cancel every event of a level that is waiting on the bus.
+     * Pre: level < LEVELS
+     * Post: Events of the level added before the call are never handled, the
+     * cost does not depend on how many are waiting.
+     */
+    void cancel_level(size_t level)
+    {
+        for (size_t p = 0; p < PARTITIONS; p++) {
+            cancel_level(level, p);
+        }
+    }
+
+    /**
+     * Description: Cancel every event of a level and a partition that is
+     * waiting on the bus, the events of the other partitions stay.
+     * Pre: level < LEVELS and partition < PARTITIONS
+     * Post: Events of the level and partition added before the call are never
+     * handled, the cost does not depend on how many are waiting.
+     */
+    void cancel_level(size_t level, size_t partition)
+    {
+        if (level < LEVELS && partition < PARTITIONS) {
+            level_generation[partition][level].fetch_add(1, std::memory_order_acq_rel);
+        }
+    }
+
+    /**
+     * Description: Cancel every event added with a correlation ID that is
+     * waiting on the bus, whatever its level.
+     * Pre: 0 < correlation < CORRELATIONS, 0 means no correlation and is ignored.
+     * Post: Events with the ID added before the call are never handled, the
+     * cost does not depend on how many are waiting.
+     */
+    void cancel_correlation(size_t correlation)
+    {
+        if (correlation != 0 && correlation < CORRELATIONS) {
+            correlation_generation[correlation].fetch_add(1, std::memory_order_acq_rel);
+        }
+    }
+
+    /**
+     * Description: Number of events waiting in every level, including the
+     * cancelled ones that were not skipped yet.
+     * Pre: None
+     * Post: Returns the pending event count.
+     */
+    size_t size() const
+    {
+        size_t total = sos_events.size();
+        for (size_t i = 0; i < LEVELS - 1; i++) {
+            total += events[i].size();
+        }
+        return total;
+    }
+
+    /**
+     * Description: Number of events that were dropped because a level was full.
+     * Pre: None
+     * Post: Returns the overflow count since boot.
+     */
+    uint32_t overflow_count() const
+    {
+        return overflows.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Description: Number of events that were cancelled before being handled.
+     * Pre: None
+     * Post: Returns the count of cancelled events skipped since boot.
+     */
+    uint32_t cancelled_count() const
+    {
+        return cancelled.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Description: The most events that were waiting on the bus at once.
+     * Pre: None
+     * Post: Returns the high water mark since boot.
+     */
+    size_t high_water_mark() const
+    {
+        return high_water.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Description: Set the clock every added event is stamped with, for
+     * example micros().
+     * Pre: Called during setup, clock is safe to call from interrupt handlers.
+     * Post: Events added from now on are stamped.
+     */
+    void set_clock(unsigned long (*clock)())
+    {
+        this->clock = clock;
+    }
+
+    /**
+     * Description: Set the level events of a kind are added to, 0 is the most
+     * urgent. Kinds without a level go into the least urgent one.
+     * Pre: Called during setup before events of this kind are added.
+     * Post: Later add() calls of this kind go into level.
+     */
+    void set_priority(size_t kind, size_t level)
+    {
+        if (kind < KINDS && level < LEVELS) {
+            level_of[kind] = (uint8_t)level;
+        }
+    }
+
+    /**
+     * Description: Mark a kind of event as idempotent so that it is folded into
+     * an identical pending event. Kinds that share a group are only folded when
+     * no other kind of the group was added after the pending one.
+     * Pre: Called during setup before events of this kind are added. Kinds of
+     * a group have the same level, and are never cancelled as a cancelled entry
+     * would still absorb the events folded into it.
+     * Post: Later add() calls of this kind may be folded.
+     */
+    void set_idempotent(size_t kind, size_t group)
+    {
+        if (kind < KINDS && group < KINDS) {
+            group_of[kind] = group;
+        }
+    }
+
+    /**
+     * Description: Number of add() calls of a kind that were folded into a
+     * pending event instead of being queued.
+     * Pre: None
+     * Post: Returns the count since boot.
      */
-    void current_completed();
-};
\ No newline at end of file
+    uint32_t coalesced_count(size_t kind) const
+    {
+        return kind < KINDS ? coalesced[kind].load(std::memory_order_relaxed) : 0;
+    }
+};
@@ -0,0 +1,49 @@
+/**
+ * Author: Malav Patel
+ * Description: Purpose of this file is to build, at compile time, the
+ * table that maps every kind of event to the function handling it.
+ */
+#pragma once
+#include <array>
+#include <cstddef>
+#include <utility>
+
+/**
+ * The table is generated from a class template Handler<I> that has to be
+ * specialised for every kind of event I from 0 to COUNT - 1, each with a
+ * static handle(const M&) function. A kind without a specialisation fails to
+ * compile (incomplete type), a kind with two fails to compile (redefinition),
+ * and since a handler is looked up by the value of its event and not by its
+ * position in a list, a handler can not end up on the wrong event.
+ */
+template <typename M>
+using EventHandlerFn = void (*)(const M&);
+
+template <typename M, template <size_t> class Handler, size_t... I>
+constexpr std::array<EventHandlerFn<M>, sizeof...(I)> make_dispatch_table(std::index_sequence<I...>)
+{
+    return { { &Handler<I>::handle... } };
+}
+
+template <typename M, template <size_t> class Handler, size_t COUNT>
+constexpr std::array<EventHandlerFn<M>, COUNT> dispatch_table()
+{
+    return make_dispatch_table<M, Handler>(std::make_index_sequence<COUNT>());
+}
+
+/**
+ * Handlers that do not need the payload of their event take no arguments,
+ * call_handler lets both kinds be used in a Handler specialisation.
+ */
+template <typename M>
+inline void call_handler(void (*handler)(), const M& message)
+{
+    (void)message;
+    handler();
+}
+
+template <typename M>
+inline void call_handler(void (*handler)(const M&), const M& message)
+{
+    handler(message);
+}
@@ -0,0 +1,178 @@
+/**
+ * Author: Malav Patel
+ * Description: Purpose of this file is to implement the flash records
+ * defined in flash_store.h
+ *
+ * On ESP32 every record is a blob in the NVS namespace FLASH_NAMESPACE, which
+ * spreads the writes over its pages. The native build keeps the records in
+ * memory, reading one costs FLASH_SIM_US_PER_KB of virtual time.
+ */
+#include "flash_store.h"
+
+#define FLASH_NAMESPACE "door"
+
+#ifdef ARDUINO
+
+#include <Preferences.h>
+
+static Preferences preferences;
+static bool opened = false;
+
+static bool open_namespace()
+{
+    if (!opened) {
+        opened = preferences.begin(FLASH_NAMESPACE, false);
+    }
+    return opened;
+}
+
+size_t flash_size(const char* name)
+{
+    if (!open_namespace() || !preferences.isKey(name)) {
+        return 0;
+    }
+    return preferences.getBytesLength(name);
+}
+
+bool flash_read(const char* name, void* data, size_t size)
+{
+    if (flash_size(name) != size) {
+        return false;
+    }
+    return preferences.getBytes(name, data, size) == size;
+}
+
+bool flash_write(const char* name, const void* data, size_t size)
+{
+    return open_namespace() && preferences.putBytes(name, data, size) == size;
+}
+
+#else
+
+#include <cstdio>
+#include <cstring>
+
+#include "native/fake_arduino.h"
+
+// Time it takes the ESP32 to read a KB of NVS, a stand-in for the real cost
+#define FLASH_SIM_US_PER_KB 120
+// Records the fake flash holds and the largest record, kept out of the heap
+// so they do not show up in the heap statistics of the device
+#define FLASH_SIM_RECORDS 8
+#define FLASH_SIM_RECORD_MAX 8192
+
+struct FlashRecord {
+    char name[16];
+    size_t size;
+    uint8_t data[FLASH_SIM_RECORD_MAX];
+};
+
+static FlashRecord records[FLASH_SIM_RECORDS];
+static int record_count = 0;
+static unsigned long writes = 0;
+static unsigned long bytes_written = 0;
+
+static FlashRecord* find(const char* name)
+{
+    for (int i = 0; i < record_count; i++) {
+        if (strcmp(records[i].name, name) == 0) {
+            return &records[i];
+        }
+    }
+    return nullptr;
+}
+
+size_t flash_size(const char* name)
+{
+    FlashRecord* record = find(name);
+    return record == nullptr ? 0 : record->size;
+}
+
+bool flash_read(const char* name, void* data, size_t size)
+{
+    FlashRecord* record = find(name);
+    if (record == nullptr || record->size != size) {
+        return false;
+    }
+    memcpy(data, record->data, size);
+    hal_sim::advance_micros((unsigned long long)size * FLASH_SIM_US_PER_KB / 1024);
+    return true;
+}
+
+bool flash_write(const char* name, const void* data, size_t size)
+{
+    FlashRecord* record = find(name);
+    if (record == nullptr) {
+        if (record_count == FLASH_SIM_RECORDS || strlen(name) >= sizeof(record->name)) {
+            return false;
+        }
+        record = &records[record_count++];
+        strcpy(record->name, name);
+    }
+    if (size > FLASH_SIM_RECORD_MAX) {
+        return false;
+    }
+    memcpy(record->data, data, size);
+    record->size = size;
+    writes++;
+    bytes_written += size;
+    return true;
+}
+
+namespace hal_sim {
+
+unsigned long flash_writes()
+{
+    return writes;
+}
+
+unsigned long flash_bytes_written()
+{
+    return bytes_written;
+}
+
+// The file holds every record as "<name> <size>\n" followed by its bytes
+bool flash_load(const char* path)
+{
+    record_count = 0;
+    FILE* file = fopen(path, "rb");
+    if (file == nullptr) {
+        return false;
+    }
+    char name[16];
+    unsigned long size;
+    bool ok = true;
+    while (fscanf(file, "%15s %lu", name, &size) == 2 && fgetc(file) == '\n') {
+        if (size > FLASH_SIM_RECORD_MAX || record_count == FLASH_SIM_RECORDS) {
+            ok = false;
+            break;
+        }
+        FlashRecord& record = records[record_count];
+        if (fread(record.data, 1, size, file) != size) {
+            ok = false;
+            break;
+        }
+        strcpy(record.name, name);
+        record.size = size;
+        record_count++;
+    }
+    fclose(file);
+    return ok;
+}
+
+bool flash_save(const char* path)
+{
+    FILE* file = fopen(path, "wb");
+    if (file == nullptr) {
+        return false;
+    }
+    for (int i = 0; i < record_count; i++) {
+        fprintf(file, "%s %lu\n", records[i].name, (unsigned long)records[i].size);
+        fwrite(records[i].data, 1, records[i].size, file);
+    }
+    return fclose(file) == 0;
+}
+
+}
+
+#endif
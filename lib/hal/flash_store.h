@@ -0,0 +1,58 @@
+/**
+ * Author: Malav Patel
+ * Description: Purpose of this file is to define how the firmware keeps
+ * small records in flash that outlive a reboot.
+ */
+#pragma once
+#include <cstddef>
+
+/**
+ * Description: Size of a record.
+ * Pre: name is at most 15 characters.
+ * Post: Returns the size in bytes, 0 if there is no such record.
+ */
+size_t flash_size(const char* name);
+
+/**
+ * Description: Read a record.
+ * Pre: name is at most 15 characters.
+ * Post: Returns false, leaving data as it was, unless a record of exactly
+ * size bytes was read into data.
+ */
+bool flash_read(const char* name, void* data, size_t size);
+
+/**
+ * Description: Write a record, replacing the one with the same name.
+ * Pre: name is at most 15 characters.
+ * Post: Returns false if the record could not be written.
+ */
+bool flash_write(const char* name, const void* data, size_t size);
+
+#ifndef ARDUINO
+namespace hal_sim {
+
+/**
+ * Description: Number of records written and the bytes they held.
+ * Pre: None
+ * Post: Returns the count since start.
+ */
+unsigned long flash_writes();
+unsigned long flash_bytes_written();
+
+/**
+ * Description: Fill the fake flash from a file written by flash_save(), so
+ * a run can start where an earlier run left off, as after a reboot.
+ * Pre: None
+ * Post: Returns false if the file could not be read, the flash is empty.
+ */
+bool flash_load(const char* path);
+
+/**
+ * Description: Write every record of the fake flash to a file.
+ * Pre: None
+ * Post: Returns false if the file could not be written.
+ */
+bool flash_save(const char* path);
+
+}
+#endif
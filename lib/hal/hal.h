@@ -0,0 +1,37 @@
+/**
+ * Author: Malav Patel
+ * Description: Purpose of this file is to be the single place that
+ * pulls in the hardware and network APIs used by the firmware.
+ *
+ * On the ESP32 (the Arduino framework defines ARDUINO) the real Arduino core,
+ * LiquidCrystal, Servo and at_client headers are included. On the native
+ * environment in-memory fakes with the same names are included instead, so
+ * that src/main.cpp can be compiled and run on the host without a board.
+ */
+#pragma once
+
+#ifdef ARDUINO
+
+#include <Arduino.h>
+#include <LiquidCrystal.h>
+#include <SPIFFS.h>
+#include <Servo.h>
+#include <WiFiClientSecure.h>
+
+#include "at_client.h"
+
+#else
+
+#include "native/fake_arduino.h"
+#include "native/fake_at_client.h"
+#include "native/fake_peripherals.h"
+
+#endif
+
+#include "flash_store.h"
+#include "heap_stats.h"
+#include "idle.h"
+#include "key_version.h"
+#include "monitor_transport.h"
+#include "net_link.h"
+#include "wall_clock.h"
@@ -0,0 +1,103 @@
+/**
+ * Author: Malav Patel
+ * Description: Purpose of this file is to implement the heap statistics
+ * defined in heap_stats.h
+ *
+ * On ESP32 they come from the ESP-IDF heap. The host has no heap of the size
+ * of the device, so the native build counts every C++ allocation against a
+ * heap of HEAP_SIM_BYTES instead and does not model fragmentation.
+ */
+#include "heap_stats.h"
+
+#ifdef ARDUINO
+
+#include <esp_heap_caps.h>
+
+size_t heap_free()
+{
+    return heap_caps_get_free_size(MALLOC_CAP_8BIT);
+}
+
+size_t heap_largest_block()
+{
+    return heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+}
+
+size_t heap_min_free()
+{
+    return heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT);
+}
+
+#else
+
+#include <atomic>
+#include <cstdlib>
+#include <malloc.h>
+#include <new>
+
+// Free heap of an ESP32 running the Arduino core with WiFi up
+#define HEAP_SIM_BYTES 262144
+
+static std::atomic<size_t> in_use(0);
+static std::atomic<size_t> peak(0);
+static std::atomic<size_t> excluded(0);
+
+void* operator new(size_t size)
+{
+    void* block = malloc(size == 0 ? 1 : size);
+    if (block == nullptr) {
+        throw std::bad_alloc();
+    }
+    size_t now = in_use.fetch_add(malloc_usable_size(block), std::memory_order_relaxed) + malloc_usable_size(block);
+    size_t seen = peak.load(std::memory_order_relaxed);
+    while (now > seen && !peak.compare_exchange_weak(seen, now, std::memory_order_relaxed)) {
+    }
+    return block;
+}
+
+void operator delete(void* block) noexcept
+{
+    if (block != nullptr) {
+        in_use.fetch_sub(malloc_usable_size(block), std::memory_order_relaxed);
+        free(block);
+    }
+}
+
+void operator delete(void* block, size_t size) noexcept
+{
+    (void)size;
+    operator delete(block);
+}
+
+static size_t remaining(size_t used)
+{
+    used = used > excluded ? used - excluded : 0;
+    return used < HEAP_SIM_BYTES ? HEAP_SIM_BYTES - used : 0;
+}
+
+size_t heap_free()
+{
+    return remaining(in_use.load(std::memory_order_relaxed));
+}
+
+size_t heap_largest_block()
+{
+    return heap_free();
+}
+
+size_t heap_min_free()
+{
+    return remaining(peak.load(std::memory_order_relaxed));
+}
+
+namespace hal_sim {
+
+void heap_exclude_current()
+{
+    excluded = in_use.load();
+    peak = excluded.load();
+}
+
+}
+
+#endif
@@ -0,0 +1,43 @@
+/**
+ * Author: Malav Patel
+ * Description: Purpose of this file is to define how the firmware reads the
+ * state of its heap, so it can verify that long runs do not fragment it.
+ */
+#pragma once
+#include <cstddef>
+
+/**
+ * Description: Bytes of heap that are free right now.
+ * Pre: None
+ * Post: Returns the free byte count.
+ */
+size_t heap_free();
+
+/**
+ * Description: The largest block of heap that could be allocated at once,
+ * far below heap_free() when the heap is fragmented.
+ * Pre: None
+ * Post: Returns the size of the block in bytes.
+ */
+size_t heap_largest_block();
+
+/**
+ * Description: The least heap that was ever free since boot.
+ * Pre: None
+ * Post: Returns the low water mark in bytes.
+ */
+size_t heap_min_free();
+
+#ifndef ARDUINO
+namespace hal_sim {
+
+/**
+ * Description: Leave what is allocated right now, by the host driver before
+ * setup(), out of the heap statistics of the native build.
+ * Pre: None
+ * Post: heap_free() and heap_min_free() only count later allocations.
+ */
+void heap_exclude_current();
+
+}
+#endif
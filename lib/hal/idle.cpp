@@ -0,0 +1,197 @@
+/**
+ * Author: Malav Patel
+ * Description: Purpose of this file is to implement the idle wait defined
+ * in idle.h
+ *
+ * On ESP32 the main task blocks on its task notification. With power
+ * management enabled the FreeRTOS idle task then puts the chip in light
+ * sleep until the next tick any task waits for, a wake pin or the radio
+ * needs it. The native build moves the virtual clock instead and charges
+ * IDLE_SIM_WAKE_US for coming back.
+ */
+#include "idle.h"
+
+#ifdef ARDUINO
+
+#include <Arduino.h>
+#include <atomic>
+#include <driver/gpio.h>
+#include <esp_pm.h>
+#include <esp_sleep.h>
+
+// Lowest CPU clock while no task needs more, the lowest WiFi works with
+#define IDLE_MIN_FREQ_MHZ 80
+
+struct WakePin {
+    gpio_num_t pin;
+    gpio_int_type_t edge;
+};
+
+static WakePin wake_pins[IDLE_WAKE_PINS_MAX];
+static int wake_pin_count = 0;
+static TaskHandle_t idle_task = nullptr;
+static std::atomic<bool> waiting(false);
+static bool light_sleep = false;
+
+void idle_start()
+{
+    idle_task = xTaskGetCurrentTaskHandle();
+
+#if CONFIG_PM_ENABLE && CONFIG_FREERTOS_USE_TICKLESS_IDLE
+    esp_pm_config_esp32_t config = {};
+    config.max_freq_mhz = CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ;
+    config.min_freq_mhz = IDLE_MIN_FREQ_MHZ;
+    config.light_sleep_enable = true;
+    light_sleep = esp_pm_configure(&config) == ESP_OK;
+#endif
+
+    esp_sleep_enable_gpio_wakeup();
+}
+
+void idle_wake_on(uint8_t pin, int mode)
+{
+    if (wake_pin_count == IDLE_WAKE_PINS_MAX) {
+        return;
+    }
+    WakePin& wake_pin = wake_pins[wake_pin_count++];
+    wake_pin.pin = (gpio_num_t)pin;
+    wake_pin.edge = mode == RISING ? GPIO_INTR_POSEDGE : mode == FALLING ? GPIO_INTR_NEGEDGE : GPIO_INTR_ANYEDGE;
+}
+
+void idle_prepare()
+{
+    ulTaskNotifyTake(pdTRUE, 0);
+}
+
+bool idle_wait(unsigned long ms)
+{
+    // Light sleep is only woken by the level of a pin, so every pin waits for
+    // the level it does not have now. Its interrupt fires on that level too,
+    // idle_wake_from_isr() puts the edge back before it can fire again.
+    // waiting is set before the first pin is switched to its level and only
+    // cleared once every edge is back, otherwise an input in between would
+    // leave its level interrupt firing until the wait ends.
+    waiting = true;
+    for (int i = 0; i < wake_pin_count; i++) {
+        gpio_num_t pin = wake_pins[i].pin;
+        gpio_wakeup_enable(pin, gpio_get_level(pin) ? GPIO_INTR_LOW_LEVEL : GPIO_INTR_HIGH_LEVEL);
+    }
+
+    bool woken = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(ms)) > 0;
+
+    for (int i = 0; i < wake_pin_count; i++) {
+        gpio_wakeup_disable(wake_pins[i].pin);
+        gpio_set_intr_type(wake_pins[i].pin, wake_pins[i].edge);
+    }
+    waiting = false;
+    return woken;
+}
+
+void idle_wake()
+{
+    if (idle_task != nullptr) {
+        xTaskNotifyGive(idle_task);
+    }
+}
+
+void IRAM_ATTR idle_wake_from_isr(uint8_t pin)
+{
+    if (waiting) {
+        for (int i = 0; i < wake_pin_count; i++) {
+            if (wake_pins[i].pin == (gpio_num_t)pin) {
+                gpio_set_intr_type(wake_pins[i].pin, wake_pins[i].edge);
+            }
+        }
+    }
+
+    if (idle_task != nullptr) {
+        BaseType_t higher_priority_woken = pdFALSE;
+        vTaskNotifyGiveFromISR(idle_task, &higher_priority_woken);
+        if (higher_priority_woken) {
+            portYIELD_FROM_ISR();
+        }
+    }
+}
+
+bool idle_light_sleep()
+{
+    return light_sleep;
+}
+
+#else
+
+#include <atomic>
+
+#include "native/fake_arduino.h"
+
+// Stand-in for the time the ESP32 takes to leave light sleep and switch back
+// to the main task
+#define IDLE_SIM_WAKE_US 500
+
+static void (*idle_step)() = nullptr;
+static std::atomic<bool> woken(false);
+static unsigned long long idle_us = 0;
+
+void idle_start()
+{
+}
+
+void idle_wake_on(uint8_t pin, int mode)
+{
+    (void)pin;
+    (void)mode;
+}
+
+void idle_prepare()
+{
+    woken = false;
+}
+
+bool idle_wait(unsigned long ms)
+{
+    if (idle_step == nullptr || woken) {
+        return woken.exchange(false);
+    }
+
+    unsigned long long started = micros();
+    unsigned long until = millis() + ms;
+    while (!woken && (long)(until - millis()) > 0) {
+        idle_step();
+    }
+    hal_sim::advance_micros(IDLE_SIM_WAKE_US);
+    idle_us += micros() - started;
+
+    return woken.exchange(false);
+}
+
+void idle_wake()
+{
+    woken = true;
+}
+
+void idle_wake_from_isr(uint8_t pin)
+{
+    (void)pin;
+    woken = true;
+}
+
+bool idle_light_sleep()
+{
+    return idle_step != nullptr;
+}
+
+namespace hal_sim {
+
+void set_idle_step(void (*step)())
+{
+    idle_step = step;
+}
+
+unsigned long long idle_micros()
+{
+    return idle_us;
+}
+
+}
+
+#endif
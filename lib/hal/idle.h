@@ -0,0 +1,87 @@
+/**
+ * Author: Malav Patel
+ * Description: Purpose of this file is to define how the main loop waits
+ * while it has nothing to do, so the ESP32 can sleep in the meantime.
+ */
+#pragma once
+#include <cstdint>
+
+// Pins that can wake the main loop
+#define IDLE_WAKE_PINS_MAX 4
+
+/**
+ * Description: Let the ESP32 enter light sleep while every task waits.
+ * Pre: Called once from the task that calls idle_wait().
+ * Post: idle_light_sleep() reports if light sleep could be enabled.
+ */
+void idle_start();
+
+/**
+ * Description: Wake the main loop when a pin changes.
+ * Pre: attachInterrupt() was called for the pin with mode, and its handler
+ * calls idle_wake_from_isr(pin).
+ * Post: While idle_wait() waits, a change of the pin wakes the ESP32.
+ */
+void idle_wake_on(uint8_t pin, int mode);
+
+/**
+ * Description: Forget the wakes that came before, called before the main
+ * loop checks whether it has something to do.
+ * Pre: None
+ * Post: A wake from now on makes the next idle_wait() return right away.
+ */
+void idle_prepare();
+
+/**
+ * Description: Wait until ms have passed or something woke the main loop.
+ * Pre: idle_prepare() was called after the last check for work.
+ * Post: Returns true if it was woken before ms had passed.
+ */
+bool idle_wait(unsigned long ms);
+
+/**
+ * Description: Wake the main loop from another task.
+ * Pre: None
+ * Post: idle_wait() returns.
+ */
+void idle_wake();
+
+/**
+ * Description: Wake the main loop from the interrupt handler of a pin.
+ * Pre: Called from an interrupt handler.
+ * Post: idle_wait() returns.
+ */
+void idle_wake_from_isr(uint8_t pin);
+
+/**
+ * Description: Checks if the ESP32 enters light sleep while the main loop
+ * waits, it only does so if ESP-IDF was built with power management and
+ * tickless idle. Otherwise the cores only idle until the next interrupt.
+ * Pre: idle_start() was called.
+ * Post: Returns true if light sleep is enabled.
+ */
+bool idle_light_sleep();
+
+#ifndef ARDUINO
+namespace hal_sim {
+
+/**
+ * Description: Set what is done for every virtual millisecond that
+ * idle_wait() waits. Without it idle_wait() returns right away, which is what
+ * the native build, whose driver moves the clock itself, wants.
+ * Pre: step does not call loop().
+ * Post: idle_wait() moves the virtual clock a millisecond at a time, calling
+ * step, until it is woken or ms have passed.
+ */
+void set_idle_step(void (*step)());
+
+/**
+ * Description: Total virtual time that was spent inside idle_wait(),
+ * including the time it took to wake up.
+ * Pre: None
+ * Post: Returns microseconds since start.
+ */
+unsigned long long idle_micros();
+
+}
+#endif
@@ -0,0 +1,20 @@
+/**
+ * Author: Malav Patel
+ * Description: Purpose of this file is to provide the metadata lookup
+ * for the ESP32 build.
+ */
+#ifdef ARDUINO
+
+#include "key_version.h"
+
+// The at_client release used on ESP32 only exposes put/get and does not send
+// the llookup:meta verb, so the value is read on every poll.
+bool net_key_version(AtClient* client, const AtKey* key, uint32_t& version)
+{
+    (void)client;
+    (void)key;
+    (void)version;
+    return false;
+}
+
+#endif
@@ -0,0 +1,20 @@
+/**
+ * Author: Malav Patel
+ * Description: Purpose of this file is to define the metadata lookup that
+ * tells whether a key on the AtSign secondary server was updated, without
+ * reading and decrypting its value.
+ */
+#pragma once
+#include <cstdint>
+
+class AtClient;
+class AtKey;
+
+/**
+ * Description: Look up the version of key, which the secondary server moves
+ * on every update of the key. Blocks, only called from the network task.
+ * Pre: client has been authenticated.
+ * Post: Returns false if the lookup failed or the build has no way to look
+ * up metadata, in which case the value has to be read to see if it changed.
+ */
+bool net_key_version(AtClient* client, const AtKey* key, uint32_t& version);
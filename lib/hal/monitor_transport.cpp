@@ -0,0 +1,19 @@
+/**
+ * Author: Malav Patel
+ * Description: Purpose of this file is to provide the monitor
+ * connection for the ESP32 build.
+ */
+#ifdef ARDUINO
+
+#include "monitor_transport.h"
+
+// The at_client release used on ESP32 only exposes put/get and does not
+// give access to an authenticated connection that the monitor verb could be
+// sent on, so the device build does not support push: AtMonitor starts no
+// task and app_events_key is polled every APP_E_POLL_MS.
+MonitorTransport* monitor_transport()
+{
+    return nullptr;
+}
+
+#endif
@@ -0,0 +1,53 @@
+/**
+ * Author: Malav Patel
+ * Description: Purpose of this file is to define the connection used to
+ * receive atProtocol monitor notifications from the AtSign secondary server.
+ */
+#pragma once
+#include <cstddef>
+
+/**
+ * A connection to the secondary server that has been authenticated and sent
+ * the monitor verb, after which the server writes one notification per line.
+ */
+class MonitorTransport {
+public:
+    virtual ~MonitorTransport() { }
+
+    /**
+     * Description: Connect, authenticate and send "monitor <regex>".
+     * Pre: None
+     * Post: Returns true if notifications matching regex will now be received.
+     */
+    virtual bool open(const char* regex) = 0;
+
+    /**
+     * Description: Block until the server sends a line.
+     * Pre: open() returned true.
+     * Post: Returns the length of the line copied into buffer (without the
+     * newline, truncated to size - 1), or -1 once the connection is lost.
+     */
+    virtual int read_line(char* buffer, size_t size) = 0;
+
+    /**
+     * Description: Checks if read_line() would return without blocking.
+     * Pre: None
+     * Post: Returns true if a line is waiting or the connection is lost.
+     */
+    virtual bool readable() = 0;
+
+    /**
+     * Description: Close the connection, unblocking a read_line() in progress.
+     * Pre: None
+     * Post: read_line() returns -1 until open() is called again.
+     */
+    virtual void close() = 0;
+};
+
+/**
+ * Description: The monitor connection of this build.
+ * Pre: None
+ * Post: Returns nullptr if the build has no way to monitor the secondary
+ * server, in which case the firmware keeps polling.
+ */
+MonitorTransport* monitor_transport();
@@ -0,0 +1,205 @@
+/**
+ * Author: Malav Patel
+ * Description: Purpose of this file is to implement the fake
+ * Arduino core defined in fake_arduino.h
+ */
+#ifndef ARDUINO
+
+#include "fake_arduino.h"
+
+#include <iostream>
+#include <string>
+
+static const int PIN_COUNT = 40;
+
+static unsigned long long now_us = 0;
+static unsigned long long delayed_ms = 0;
+static int pin_levels[PIN_COUNT] = { 0 };
+static void (*pin_handlers[PIN_COUNT])() = { nullptr };
+static int pin_modes[PIN_COUNT] = { 0 };
+static std::string serial_buffer;
+
+// Microseconds to send a byte, 10 bits with start and stop bit
+static unsigned long long serial_byte_us = 87;
+// When the last byte written will have been sent
+static unsigned long long serial_sent_at = 0;
+static unsigned long long serial_written = 0;
+static unsigned long long serial_blocked_us = 0;
+
+struct SimTask {
+    void (*step)(void*);
+    void* arg;
+};
+
+static SimTask tasks[SIM_TASKS_MAX];
+static int task_count = 0;
+
+HardwareSerial Serial;
+
+unsigned long millis()
+{
+    return (unsigned long)(now_us / 1000);
+}
+
+unsigned long micros()
+{
+    return (unsigned long)now_us;
+}
+
+void delay(uint32_t ms)
+{
+    delayed_ms += ms;
+    now_us += (unsigned long long)ms * 1000;
+}
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+    (void)pin;
+    (void)mode;
+}
+
+int digitalRead(uint8_t pin)
+{
+    return pin < PIN_COUNT ? pin_levels[pin] : LOW;
+}
+
+void attachInterrupt(uint8_t pin, void (*handler)(), int mode)
+{
+    if (pin < PIN_COUNT) {
+        pin_handlers[pin] = handler;
+        pin_modes[pin] = mode;
+    }
+}
+
+void HardwareSerial::begin(unsigned long baud)
+{
+    serial_byte_us = baud > 0 ? 10000000ULL / baud : 0;
+}
+
+int HardwareSerial::available()
+{
+    return (int)serial_buffer.size();
+}
+
+int HardwareSerial::read()
+{
+    if (serial_buffer.empty()) {
+        return -1;
+    }
+    int c = (unsigned char)serial_buffer[0];
+    serial_buffer.erase(0, 1);
+    return c;
+}
+
+int HardwareSerial::availableForWrite()
+{
+    if (serial_sent_at <= now_us || serial_byte_us == 0) {
+        return SIM_SERIAL_TX_BUFFER;
+    }
+    unsigned long long queued = (serial_sent_at - now_us + serial_byte_us - 1) / serial_byte_us;
+    return queued >= SIM_SERIAL_TX_BUFFER ? 0 : SIM_SERIAL_TX_BUFFER - (int)queued;
+}
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size)
+{
+    std::cout.write((const char*)buffer, (std::streamsize)size);
+    serial_written += size;
+
+    if (serial_sent_at < now_us) {
+        serial_sent_at = now_us;
+    }
+    serial_sent_at += size * serial_byte_us;
+
+    // Returns once all but a full buffer is sent
+    unsigned long long buffered_us = (unsigned long long)SIM_SERIAL_TX_BUFFER * serial_byte_us;
+    if (serial_sent_at - now_us > buffered_us) {
+        unsigned long long blocked = serial_sent_at - now_us - buffered_us;
+        serial_blocked_us += blocked;
+        now_us += blocked;
+    }
+    return size;
+}
+
+namespace hal_sim {
+
+unsigned long long serial_bytes()
+{
+    return serial_written;
+}
+
+unsigned long long serial_blocked_micros()
+{
+    return serial_blocked_us;
+}
+
+void advance_millis(unsigned long ms)
+{
+    now_us += (unsigned long long)ms * 1000;
+}
+
+void advance_micros(unsigned long long us)
+{
+    now_us += us;
+}
+
+void set_pin(uint8_t pin, int level)
+{
+    if (pin < PIN_COUNT) {
+        pin_levels[pin] = level;
+    }
+}
+
+void drive_pin(uint8_t pin, int level)
+{
+    if (pin >= PIN_COUNT) {
+        return;
+    }
+    int previous = pin_levels[pin];
+    pin_levels[pin] = level;
+    if (pin_handlers[pin] == nullptr || previous == level) {
+        return;
+    }
+    bool rising = previous == LOW && level == HIGH;
+    if (pin_modes[pin] == CHANGE
+        || (pin_modes[pin] == RISING && rising)
+        || (pin_modes[pin] == FALLING && !rising)) {
+        pin_handlers[pin]();
+    }
+}
+
+void fire_interrupt(uint8_t pin)
+{
+    if (pin < PIN_COUNT && pin_handlers[pin] != nullptr) {
+        pin_handlers[pin]();
+    }
+}
+
+unsigned long long delayed_millis()
+{
+    return delayed_ms;
+}
+
+void serial_input(const char* text)
+{
+    serial_buffer += text;
+}
+
+void add_task(void (*step)(void*), void* arg)
+{
+    if (task_count < SIM_TASKS_MAX) {
+        tasks[task_count].step = step;
+        tasks[task_count].arg = arg;
+        task_count++;
+    }
+}
+
+void run_tasks()
+{
+    for (int i = 0; i < task_count; i++) {
+        tasks[i].step(tasks[i].arg);
+    }
+}
+
+}
+
+#endif
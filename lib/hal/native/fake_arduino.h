@@ -0,0 +1,135 @@
+/**
+ * Author: Malav Patel
+ * Description: Purpose of this file is to define a fake of the parts of the
+ * Arduino core used by the firmware, so it can run on the host.
+ *
+ * Time is virtual: millis() and micros() only move when delay() is called or
+ * when the host driver calls hal_sim::advance_millis().
+ */
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+
+#define LOW 0x0
+#define HIGH 0x1
+
+#define RISING 0x01
+#define FALLING 0x02
+#define CHANGE 0x03
+
+#define IRAM_ATTR
+
+#define digitalPinToInterrupt(p) (p)
+
+// Background tasks that can be stepped by hal_sim::run_tasks()
+#define SIM_TASKS_MAX 4
+// Bytes the serial port queues before write() blocks, the FIFO of the UART
+#define SIM_SERIAL_TX_BUFFER 128
+
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+
+void pinMode(uint8_t pin, uint8_t mode);
+int digitalRead(uint8_t pin);
+void attachInterrupt(uint8_t pin, void (*handler)(), int mode);
+
+/**
+ * Fake of the Arduino Serial port. What is written goes to std::cout and is
+ * sent at the baud rate on the virtual clock, a write that does not fit in
+ * SIM_SERIAL_TX_BUFFER blocks until it does. Input is whatever the host driver
+ * gave hal_sim::serial_input().
+ */
+class HardwareSerial {
+public:
+    void begin(unsigned long baud);
+    int available();
+    int read();
+    int availableForWrite();
+    size_t write(const uint8_t* buffer, size_t size);
+};
+
+extern HardwareSerial Serial;
+
+namespace hal_sim {
+
+/**
+ * Description: Move the virtual clock forward.
+ * Pre: None
+ * Post: millis() and micros() will report the advanced time.
+ */
+void advance_millis(unsigned long ms);
+
+/**
+ * Description: Move the virtual clock forward by microseconds.
+ * Pre: None
+ * Post: micros() will report the advanced time.
+ */
+void advance_micros(unsigned long long us);
+
+/**
+ * Description: Set the level that digitalRead() will return for a pin.
+ * Pre: None
+ * Post: The pin level is stored, no interrupt is fired.
+ */
+void set_pin(uint8_t pin, int level);
+
+/**
+ * Description: Drive a pin to a level and fire the interrupt handler attached
+ * to it if the transition matches the mode it was attached with.
+ * Pre: None
+ * Post: The handler attached with attachInterrupt() has run if it matched.
+ */
+void drive_pin(uint8_t pin, int level);
+
+/**
+ * Description: Fire the interrupt handler attached to a pin regardless of level.
+ * Pre: None
+ * Post: The handler attached with attachInterrupt() has run.
+ */
+void fire_interrupt(uint8_t pin);
+
+/**
+ * Description: Total virtual time that was spent inside delay().
+ * Pre: None
+ * Post: Returns milliseconds blocked in delay() since start.
+ */
+unsigned long long delayed_millis();
+
+/**
+ * Description: Queue characters to be read from the fake Serial port.
+ * Pre: None
+ * Post: Serial.available() counts the characters until they are read.
+ */
+void serial_input(const char* text);
+
+/**
+ * Description: Bytes written to the fake Serial port, and the virtual time
+ * the writes blocked because its buffer was full.
+ * Pre: None
+ * Post: Returns the count since start.
+ */
+unsigned long long serial_bytes();
+unsigned long long serial_blocked_micros();
+
+/**
+ * Description: Register a step of a background task (the network worker, the
+ * monitor) that is run on the host thread instead of its own thread, so a
+ * simulation is deterministic. Only used when built with SIM_DETERMINISTIC.
+ * Pre: At most SIM_TASKS_MAX tasks are registered.
+ * Post: step(arg) is called by every run_tasks().
+ */
+void add_task(void (*step)(void*), void* arg);
+
+/**
+ * Description: Run one step of every registered task.
+ * Pre: None
+ * Post: Every task has had a chance to do the work that is due at millis().
+ */
+void run_tasks();
+
+}
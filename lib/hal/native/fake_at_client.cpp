@@ -0,0 +1,335 @@
+/**
+ * Author: Malav Patel
+ * Description: Purpose of this file is to implement the fake
+ * at_client defined in fake_at_client.h
+ */
+#ifndef ARDUINO
+
+#include "fake_at_client.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <thread>
+
+#include "fake_arduino.h"
+
+// The server is shared between the network worker thread and the host driver
+static std::mutex server_lock;
+static std::unordered_map<std::string, std::string> server;
+// Moved on every update of a key, as the updatedAt of its metadata would be
+static std::unordered_map<std::string, uint32_t> versions;
+static std::atomic<unsigned long> latency_ms(0);
+static std::atomic<unsigned long> puts_count(0);
+static std::atomic<unsigned long> gets_count(0);
+static std::atomic<unsigned long> lookups_count(0);
+static std::atomic<unsigned long> offline_until(0);
+static std::atomic<unsigned long> drops_count(0);
+
+// State of the single monitor connection the fake server accepts. The lock
+// and the condition are never destroyed, the monitor thread of the firmware
+// may still be waiting on them while static objects are torn down at exit.
+static std::mutex& monitor_lock = *new std::mutex();
+static std::condition_variable& monitor_wake = *new std::condition_variable();
+static std::deque<std::string>& monitor_lines = *new std::deque<std::string>();
+static std::string& monitor_regex = *new std::string();
+static bool monitor_open = false;
+static bool monitor_refused = false;
+static unsigned long monitor_sent = 0;
+
+// A deterministic simulation spends the latency in virtual time instead
+static void round_trip()
+{
+#ifdef SIM_DETERMINISTIC
+    unsigned long ms = 0;
+#else
+    unsigned long ms = latency_ms.load();
+#endif
+    if (ms > 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+    }
+}
+
+AtSign::AtSign(const std::string& name)
+    : name(name)
+{
+}
+
+AtKey::AtKey(const std::string& name, const AtSign* shared_by, const AtSign* shared_with)
+    : name(name)
+    , shared_by(shared_by)
+    , shared_with(shared_with)
+{
+}
+
+AtClient::AtClient(const AtSign& atsign, const std::unordered_map<std::string, std::string>& keys)
+{
+    (void)atsign;
+    (void)keys;
+}
+
+void AtClient::pkam_authenticate(const std::string& ssid, const std::string& password)
+{
+    (void)ssid;
+    (void)password;
+    round_trip();
+}
+
+void AtClient::put_ak(const AtKey& at_key, const std::string& value)
+{
+    round_trip();
+    if (!hal_sim::network_online()) {
+        return;
+    }
+    puts_count++;
+    std::lock_guard<std::mutex> guard(server_lock);
+    server[at_key.name] = value;
+    versions[at_key.name]++;
+}
+
+std::string AtClient::get_ak(const AtKey& at_key)
+{
+    round_trip();
+    if (!hal_sim::network_online()) {
+        return std::string();
+    }
+    gets_count++;
+    std::lock_guard<std::mutex> guard(server_lock);
+    auto it = server.find(at_key.name);
+    return it == server.end() ? std::string() : it->second;
+}
+
+bool net_key_version(AtClient* client, const AtKey* key, uint32_t& version)
+{
+    (void)client;
+    round_trip();
+    if (!hal_sim::network_online()) {
+        return false;
+    }
+    lookups_count++;
+    std::lock_guard<std::mutex> guard(server_lock);
+    auto it = versions.find(key->name);
+    version = it == versions.end() ? 0 : it->second;
+    return true;
+}
+
+bool FakeMonitorTransport::open(const char* regex)
+{
+    round_trip();
+    std::lock_guard<std::mutex> guard(monitor_lock);
+    if (monitor_refused || !hal_sim::network_online()) {
+        return false;
+    }
+    monitor_regex = regex;
+    monitor_lines.clear();
+    monitor_open = true;
+    return true;
+}
+
+int FakeMonitorTransport::read_line(char* buffer, size_t size)
+{
+    std::unique_lock<std::mutex> guard(monitor_lock);
+    monitor_wake.wait(guard, [] { return !monitor_open || !monitor_lines.empty(); });
+    if (!monitor_open) {
+        return -1;
+    }
+
+    std::string line = monitor_lines.front();
+    monitor_lines.pop_front();
+
+    size_t length = line.size() < size - 1 ? line.size() : size - 1;
+    memcpy(buffer, line.c_str(), length);
+    buffer[length] = '\0';
+    return (int)length;
+}
+
+bool FakeMonitorTransport::readable()
+{
+    std::lock_guard<std::mutex> guard(monitor_lock);
+    return !monitor_open || !monitor_lines.empty();
+}
+
+void FakeMonitorTransport::close()
+{
+    {
+        std::lock_guard<std::mutex> guard(monitor_lock);
+        monitor_open = false;
+    }
+    monitor_wake.notify_all();
+}
+
+MonitorTransport* monitor_transport()
+{
+    static FakeMonitorTransport fake_monitor;
+    return &fake_monitor;
+}
+
+// Time the ESP32 takes to read the keys file from SPIFFS and decode it, a
+// stand-in for the real cost
+#define KEYS_READ_SIM_MS 240
+
+static unsigned long keys_read_count = 0;
+
+namespace keys_reader {
+std::unordered_map<std::string, std::string> read_keys(const AtSign& atsign)
+{
+    // Keys of the sizes of the real ones: four RSA-2048 keys and an AES key,
+    // base64 encoded, made up from the AtSign so they are the same every run
+    static const char* const names[] = { "aesPkamPublicKey", "aesPkamPrivateKey",
+        "aesEncryptPublicKey", "aesEncryptPrivateKey", "selfEncryptionKey" };
+    static const size_t sizes[] = { 392, 1624, 392, 1624, 44 };
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    std::unordered_map<std::string, std::string> keys;
+    uint32_t seed = 2166136261u;
+    for (char c : atsign.name) {
+        seed = (seed ^ (uint8_t)c) * 16777619u;
+    }
+    for (int i = 0; i < 5; i++) {
+        std::string value(sizes[i], '=');
+        for (size_t j = 0; j + 2 < sizes[i]; j++) {
+            seed = seed * 1103515245u + 12345u;
+            value[j] = alphabet[(seed >> 16) & 63];
+        }
+        keys[names[i]] = value;
+    }
+
+    keys_read_count++;
+    hal_sim::advance_millis(KEYS_READ_SIM_MS);
+    return keys;
+}
+}
+
+namespace hal_sim {
+
+void server_put(const std::string& key, const std::string& value)
+{
+    {
+        std::lock_guard<std::mutex> guard(server_lock);
+        server[key] = value;
+        versions[key]++;
+    }
+
+    std::lock_guard<std::mutex> guard(monitor_lock);
+    if (!monitor_open || key.find(monitor_regex) == std::string::npos) {
+        return;
+    }
+
+    std::string escaped;
+    for (char c : value) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+        }
+        escaped += c;
+    }
+
+    monitor_sent++;
+    monitor_lines.push_back("notification: {\"id\":\"" + std::to_string(monitor_sent)
+        + "\",\"key\":\"@device:" + key + ".@app\",\"value\":\"" + escaped
+        + "\",\"operation\":\"update\"}");
+    monitor_wake.notify_all();
+}
+
+std::string server_get(const std::string& key)
+{
+    std::lock_guard<std::mutex> guard(server_lock);
+    auto it = server.find(key);
+    return it == server.end() ? std::string() : it->second;
+}
+
+bool server_load(const char* path)
+{
+    std::lock_guard<std::mutex> guard(server_lock);
+    server.clear();
+    versions.clear();
+    std::ifstream file(path);
+    std::string key;
+    std::string value;
+    while (file >> key && file.get() == ' ' && std::getline(file, value)) {
+        server[key] = value;
+        versions[key] = 1;
+    }
+    return (bool)file || file.eof();
+}
+
+bool server_save(const char* path)
+{
+    std::lock_guard<std::mutex> guard(server_lock);
+    std::ofstream file(path);
+    for (const auto& entry : server) {
+        file << entry.first << ' ' << entry.second << '\n';
+    }
+    return (bool)file;
+}
+
+void set_network_latency_millis(unsigned long ms)
+{
+    latency_ms = ms;
+}
+
+unsigned long network_latency_millis()
+{
+    return latency_ms;
+}
+
+unsigned long keys_reads()
+{
+    return keys_read_count;
+}
+
+unsigned long server_puts()
+{
+    return puts_count;
+}
+
+unsigned long server_gets()
+{
+    return gets_count;
+}
+
+unsigned long server_lookups()
+{
+    return lookups_count;
+}
+
+void monitor_drop()
+{
+    monitor_transport()->close();
+}
+
+void monitor_refuse(bool refuse)
+{
+    std::lock_guard<std::mutex> guard(monitor_lock);
+    monitor_refused = refuse;
+}
+
+unsigned long monitor_notifications()
+{
+    std::lock_guard<std::mutex> guard(monitor_lock);
+    return monitor_sent;
+}
+
+void network_offline(unsigned long ms)
+{
+    offline_until = millis() + ms;
+    drops_count++;
+    monitor_transport()->close();
+}
+
+bool network_online()
+{
+    return (long)(millis() - offline_until.load()) >= 0;
+}
+
+unsigned long network_drops()
+{
+    return drops_count;
+}
+
+}
+
+#endif
@@ -0,0 +1,188 @@
+/**
+ * Author: Malav Patel
+ * Description: Purpose of this file is to define a fake of the at_client
+ * library that keeps the AtSign secondary server in memory.
+ */
+#pragma once
+#include <string>
+#include <unordered_map>
+
+#include "../key_version.h"
+#include "../monitor_transport.h"
+
+/**
+ * Fake of the at_client AtSign, only remembers the name.
+ */
+class AtSign {
+public:
+    std::string name;
+
+    explicit AtSign(const std::string& name);
+};
+
+/**
+ * Fake of the at_client AtKey.
+ */
+class AtKey {
+public:
+    std::string name;
+    const AtSign* shared_by;
+    const AtSign* shared_with;
+
+    AtKey(const std::string& name, const AtSign* shared_by, const AtSign* shared_with);
+};
+
+/**
+ * Fake of the at_client AtClient. Every instance talks to the same in-memory
+ * secondary server, so the host driver can play the role of the client
+ * Application by reading and writing keys through hal_sim.
+ */
+class AtClient {
+public:
+    AtClient(const AtSign& atsign, const std::unordered_map<std::string, std::string>& keys);
+
+    void pkam_authenticate(const std::string& ssid, const std::string& password);
+    void put_ak(const AtKey& at_key, const std::string& value);
+    std::string get_ak(const AtKey& at_key);
+};
+
+namespace keys_reader {
+std::unordered_map<std::string, std::string> read_keys(const AtSign& atsign);
+}
+
+/**
+ * A stand-in for a monitor connection to the fake secondary server. Every
+ * hal_sim::server_put() of a key matching the monitored regex is delivered
+ * as an atProtocol notification line.
+ */
+class FakeMonitorTransport : public MonitorTransport {
+public:
+    bool open(const char* regex) override;
+    int read_line(char* buffer, size_t size) override;
+    bool readable() override;
+    void close() override;
+};
+
+namespace hal_sim {
+
+/**
+ * Description: Write a key on the fake secondary server as the client Application would.
+ * Pre: None
+ * Post: The next get_ak() of a key with this name returns value.
+ */
+void server_put(const std::string& key, const std::string& value);
+
+/**
+ * Description: Read a key from the fake secondary server.
+ * Pre: None
+ * Post: Returns the stored value or an empty string.
+ */
+std::string server_get(const std::string& key);
+
+/**
+ * Description: Fill the fake secondary server from a file written by
+ * server_save(), so a run can start where an earlier run left off.
+ * Pre: None
+ * Post: Returns false if the file could not be read, the server is empty.
+ */
+bool server_load(const char* path);
+
+/**
+ * Description: Write every key of the fake secondary server to a file, one
+ * "<key> <value>" line each.
+ * Pre: None
+ * Post: Returns false if the file could not be written.
+ */
+bool server_save(const char* path);
+
+/**
+ * Description: Wall clock time every put_ak() and get_ak() blocks the calling
+ * thread for, standing in for a TLS round trip. When built with
+ * SIM_DETERMINISTIC requests do not block, the network worker instead
+ * completes them after this much virtual time.
+ * Pre: None
+ * Post: Later requests take ms.
+ */
+void set_network_latency_millis(unsigned long ms);
+
+/**
+ * Description: The latency set with set_network_latency_millis().
+ * Pre: None
+ * Post: Returns milliseconds.
+ */
+unsigned long network_latency_millis();
+
+/**
+ * Description: Number of times keys_reader::read_keys() read the keys file.
+ * Pre: None
+ * Post: Returns the count since start.
+ */
+unsigned long keys_reads();
+
+/**
+ * Description: Number of put_ak() requests sent to the fake server.
+ * Pre: None
+ * Post: Returns the count since start.
+ */
+unsigned long server_puts();
+
+/**
+ * Description: Number of get_ak() requests sent to the fake server.
+ * Pre: None
+ * Post: Returns the count since start.
+ */
+unsigned long server_gets();
+
+/**
+ * Description: Number of metadata lookups (net_key_version()) sent to the
+ * fake server.
+ * Pre: None
+ * Post: Returns the count since start.
+ */
+unsigned long server_lookups();
+
+/**
+ * Description: Drop the monitor connection as if the network went away.
+ * Pre: None
+ * Post: A read_line() in progress returns -1.
+ */
+void monitor_drop();
+
+/**
+ * Description: Make the fake server accept or refuse monitor connections.
+ * Pre: None
+ * Post: Later open() calls fail while refused.
+ */
+void monitor_refuse(bool refuse);
+
+/**
+ * Description: Number of notifications the fake server has delivered.
+ * Pre: None
+ * Post: Returns the count since start.
+ */
+unsigned long monitor_notifications();
+
+/**
+ * Description: Take the network away for ms of virtual time, as if WiFi or
+ * the secondary server went down.
+ * Pre: None
+ * Post: The monitor connection is dropped. Until ms have passed puts are
+ * lost, gets read nothing and connections are refused.
+ */
+void network_offline(unsigned long ms);
+
+/**
+ * Description: Checks if the network is there.
+ * Pre: None
+ * Post: Returns false while a network_offline() lasts.
+ */
+bool network_online();
+
+/**
+ * Description: Number of times network_offline() took the network away.
+ * Pre: None
+ * Post: Returns the count since start.
+ */
+unsigned long network_drops();
+
+}
@@ -0,0 +1,141 @@
+/**
+ * Author: Malav Patel
+ * Description: Purpose of this file is to implement the fake
+ * peripherals defined in fake_peripherals.h
+ */
+#ifndef ARDUINO
+
+#include "fake_peripherals.h"
+
+static const uint8_t LCD_MAX_COLS = 40;
+static const uint8_t LCD_MAX_ROWS = 4;
+static const int SERVO_MAX_PINS = 40;
+
+static int servo_last_angle = 0;
+static int servo_pin_angle[SERVO_MAX_PINS];
+static unsigned long servo_write_count = 0;
+
+static char lcd_cells[LCD_MAX_ROWS][LCD_MAX_COLS];
+static uint8_t lcd_cols = LCD_MAX_COLS;
+static uint8_t lcd_rows = 1;
+static uint8_t lcd_col = 0;
+static uint8_t lcd_row_index = 0;
+static unsigned long lcd_bytes = 0;
+
+bool Servo::attach(int pin)
+{
+    this->pin = pin >= 0 && pin < SERVO_MAX_PINS ? pin : -1;
+    return true;
+}
+
+void Servo::write(int value)
+{
+    if (value < 0) {
+        value = 0;
+    } else if (value > 180) {
+        value = 180;
+    }
+    angle = value;
+    servo_last_angle = value;
+    if (pin >= 0) {
+        servo_pin_angle[pin] = value;
+    }
+    servo_write_count++;
+}
+
+int Servo::read() const
+{
+    return angle;
+}
+
+LiquidCrystal::LiquidCrystal(uint8_t rs, uint8_t rw, uint8_t enable,
+    uint8_t d4, uint8_t d5, uint8_t d6, uint8_t d7)
+{
+    (void)rs;
+    (void)rw;
+    (void)enable;
+    (void)d4;
+    (void)d5;
+    (void)d6;
+    (void)d7;
+}
+
+void LiquidCrystal::begin(uint8_t cols, uint8_t rows)
+{
+    lcd_cols = cols < LCD_MAX_COLS ? cols : LCD_MAX_COLS;
+    lcd_rows = rows < LCD_MAX_ROWS ? rows : LCD_MAX_ROWS;
+    clear();
+}
+
+void LiquidCrystal::clear()
+{
+    for (uint8_t r = 0; r < LCD_MAX_ROWS; r++) {
+        for (uint8_t c = 0; c < LCD_MAX_COLS; c++) {
+            lcd_cells[r][c] = ' ';
+        }
+    }
+    lcd_col = 0;
+    lcd_row_index = 0;
+    lcd_bytes++;
+}
+
+void LiquidCrystal::setCursor(uint8_t col, uint8_t row)
+{
+    lcd_col = col;
+    lcd_row_index = row < lcd_rows ? row : lcd_rows - 1;
+    lcd_bytes++;
+}
+
+size_t LiquidCrystal::write(uint8_t value)
+{
+    if (lcd_col < lcd_cols) {
+        lcd_cells[lcd_row_index][lcd_col] = (char)value;
+    }
+    lcd_col++;
+    lcd_bytes++;
+    return 1;
+}
+
+size_t LiquidCrystal::write(const char* str)
+{
+    size_t n = 0;
+    while (str[n] != '\0') {
+        write((uint8_t)str[n]);
+        n++;
+    }
+    return n;
+}
+
+namespace hal_sim {
+
+int servo_angle()
+{
+    return servo_last_angle;
+}
+
+int servo_angle(int pin)
+{
+    return pin >= 0 && pin < SERVO_MAX_PINS ? servo_pin_angle[pin] : 0;
+}
+
+unsigned long servo_writes()
+{
+    return servo_write_count;
+}
+
+std::string lcd_row(uint8_t row)
+{
+    if (row >= LCD_MAX_ROWS) {
+        return "";
+    }
+    return std::string(lcd_cells[row], lcd_cols);
+}
+
+unsigned long lcd_bus_bytes()
+{
+    return lcd_bytes;
+}
+
+}
+
+#endif
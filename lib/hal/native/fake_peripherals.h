@@ -0,0 +1,79 @@
+/**
+ * Author: Malav Patel
+ * Description: Purpose of this file is to define fakes of the Servo and
+ * LiquidCrystal libraries that record what the firmware asked them to do.
+ */
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * Fake of the ServoESP32 Servo class, remembers the last angle written, and
+ * for every pin the angle of the servo attached to it.
+ */
+class Servo {
+    int angle = 0;
+    int pin = -1;
+
+public:
+    bool attach(int pin);
+    void write(int value);
+    int read() const;
+};
+
+/**
+ * Fake of the LiquidCrystal class. Keeps a copy of what would be visible on
+ * the display and counts the bytes that would have gone over the 4-bit bus.
+ */
+class LiquidCrystal {
+public:
+    LiquidCrystal(uint8_t rs, uint8_t rw, uint8_t enable,
+        uint8_t d4, uint8_t d5, uint8_t d6, uint8_t d7);
+
+    void begin(uint8_t cols, uint8_t rows);
+    void clear();
+    void setCursor(uint8_t col, uint8_t row);
+    size_t write(uint8_t value);
+    size_t write(const char* str);
+};
+
+namespace hal_sim {
+
+/**
+ * Description: Angle the fake servo was last written with.
+ * Pre: None
+ * Post: Returns the angle in degrees.
+ */
+int servo_angle();
+
+/**
+ * Description: Angle the fake servo attached to a pin was last written with.
+ * Pre: None
+ * Post: Returns the angle in degrees, 0 if no servo was attached to pin.
+ */
+int servo_angle(int pin);
+
+/**
+ * Description: Number of times the fake servo was written to.
+ * Pre: None
+ * Post: Returns the write count since start.
+ */
+unsigned long servo_writes();
+
+/**
+ * Description: The text currently visible on a row of the fake LCD.
+ * Pre: row is less than the number of rows passed to begin()
+ * Post: Returns the row contents padded with spaces.
+ */
+std::string lcd_row(uint8_t row);
+
+/**
+ * Description: Number of bytes (commands and characters) that would have been
+ * sent over the LCD bus.
+ * Pre: None
+ * Post: Returns the byte count since start.
+ */
+unsigned long lcd_bus_bytes();
+
+}
@@ -0,0 +1,60 @@
+/**
+ * Author: Malav Patel
+ * Description: Purpose of this file is to implement the network link
+ * defined in net_link.h
+ *
+ * On ESP32 the link is WiFi, the at_client library authenticates again over
+ * a new connection. The native build asks the fake secondary server whether
+ * the host driver has taken the network away.
+ */
+#include "net_link.h"
+
+#ifdef ARDUINO
+
+#include <Arduino.h>
+#include <WiFi.h>
+
+#include "at_client.h"
+
+// Longest wait for WiFi to come back in one attempt
+#define NET_LINK_WIFI_TIMEOUT_MS 5000
+
+bool net_link_up()
+{
+    return WiFi.status() == WL_CONNECTED;
+}
+
+bool net_link_connect(AtClient* client, const char* ssid, const char* password)
+{
+    // pkam_authenticate() waits for WiFi without a timeout, so it is only
+    // called once WiFi is back
+    if (WiFi.status() != WL_CONNECTED) {
+        WiFi.begin(ssid, password);
+        unsigned long started = millis();
+        while (WiFi.status() != WL_CONNECTED) {
+            if (millis() - started >= NET_LINK_WIFI_TIMEOUT_MS) {
+                return false;
+            }
+            delay(100);
+        }
+    }
+    client->pkam_authenticate(ssid, password);
+    return net_link_up();
+}
+
+#else
+
+#include "native/fake_at_client.h"
+
+bool net_link_up()
+{
+    return hal_sim::network_online();
+}
+
+bool net_link_connect(AtClient* client, const char* ssid, const char* password)
+{
+    client->pkam_authenticate(ssid, password);
+    return net_link_up();
+}
+
+#endif
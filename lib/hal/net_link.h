@@ -0,0 +1,25 @@
+/**
+ * Author: Malav Patel
+ * Description: Purpose of this file is to define how the network task
+ * finds out that the link to the AtSign secondary server is gone, and how it
+ * brings it back.
+ */
+#pragma once
+
+class AtClient;
+
+/**
+ * Description: Checks if the device is connected to the network.
+ * Pre: None
+ * Post: Returns false once WiFi is lost.
+ */
+bool net_link_up();
+
+/**
+ * Description: Connect to WiFi again if it is down, waiting at most
+ * NET_LINK_WIFI_TIMEOUT_MS, and authenticate client with the secondary
+ * server again. Blocks, only called from the network task.
+ * Pre: client was authenticated before with the same ssid and password.
+ * Post: Returns true if the link is back.
+ */
+bool net_link_connect(AtClient* client, const char* ssid, const char* password);
@@ -0,0 +1,62 @@
+/**
+ * Author: Malav Patel
+ * Description: Purpose of this file is to implement the time of day
+ * defined in wall_clock.h
+ *
+ * On ESP32 it is kept by the SNTP client of ESP-IDF. The native build starts
+ * at WALL_CLOCK_SIM_EPOCH and follows the virtual clock of millis().
+ */
+#include "wall_clock.h"
+
+#ifdef ARDUINO
+
+#include <Arduino.h>
+#include <time.h>
+
+// Times before this are the clock counting from 1970 before SNTP set it
+#define WALL_CLOCK_VALID_AFTER 1600000000UL
+
+void wall_clock_start()
+{
+    configTime(0, 0, "pool.ntp.org", "time.nist.gov");
+}
+
+uint32_t wall_clock_seconds()
+{
+    time_t now = time(nullptr);
+    return now > (time_t)WALL_CLOCK_VALID_AFTER ? (uint32_t)now : 0;
+}
+
+#else
+
+#include "native/fake_arduino.h"
+
+// 2023-11-14 22:13:20 UTC, the same for every run
+#define WALL_CLOCK_SIM_EPOCH 1700000000UL
+
+static long skew_s = 0;
+
+void wall_clock_start()
+{
+}
+
+uint32_t wall_clock_seconds()
+{
+    return (uint32_t)((long)hal_sim::app_clock_seconds() + skew_s);
+}
+
+namespace hal_sim {
+
+void set_wall_clock_skew(long seconds)
+{
+    skew_s = seconds;
+}
+
+uint32_t app_clock_seconds()
+{
+    return (uint32_t)(WALL_CLOCK_SIM_EPOCH + millis() / 1000);
+}
+
+}
+
+#endif
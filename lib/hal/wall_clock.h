@@ -0,0 +1,44 @@
+/**
+ * Author: Malav Patel
+ * Description: Purpose of this file is to define how the firmware reads the
+ * time of day, which it shares with the client Application.
+ */
+#pragma once
+#include <cstdint>
+
+/**
+ * Description: Start keeping the time of day, on ESP32 by asking an NTP
+ * server for it.
+ * Pre: WiFi is connected.
+ * Post: wall_clock_seconds() reports the time once it is known.
+ */
+void wall_clock_start();
+
+/**
+ * Description: Seconds since 1970-01-01 UTC.
+ * Pre: None
+ * Post: Returns 0 while the time is not known yet.
+ */
+uint32_t wall_clock_seconds();
+
+#ifndef ARDUINO
+namespace hal_sim {
+
+/**
+ * Description: Set how far the clock of the device is ahead of the clock of
+ * the client Application, negative if it is behind.
+ * Pre: None
+ * Post: wall_clock_seconds() is moved by seconds.
+ */
+void set_wall_clock_skew(long seconds);
+
+/**
+ * Description: The time of day of the client Application, the virtual clock
+ * without the skew of the device.
+ * Pre: None
+ * Post: Returns seconds since 1970-01-01 UTC.
+ */
+uint32_t app_clock_seconds();
+
+}
+#endif
@@ -0,0 +1,85 @@
+/**
+ * Author: Malav Patel
+ * Description: Purpose of this file is to implement the
+ * IdleStats Class defined in idle_stats.h
+ */
+#include "idle_stats.h"
+
+IdleStats::IdleStats()
+    : idle_us(0)
+    , active_us(0)
+    , changed_at(0)
+    , sleeps(0)
+    , woken_input(0)
+    , woken_task(0)
+    , asleep(false)
+    , input_source(-1)
+    , input_at(0)
+{
+}
+
+void IdleStats::start(uint32_t now_us)
+{
+    changed_at = now_us;
+}
+
+void IdleStats::sleep_begin(uint32_t now_us)
+{
+    active_us += now_us - changed_at;
+    changed_at = now_us;
+    input_source = -1;
+    asleep = true;
+}
+
+void IdleStats::sleep_end(uint32_t now_us, bool woken)
+{
+    asleep = false;
+    idle_us += now_us - changed_at;
+    changed_at = now_us;
+    sleeps++;
+
+    if (input_source >= 0) {
+        woken_input++;
+        wake_latency[input_source].record(now_us - input_at);
+    } else if (woken) {
+        woken_task++;
+    }
+}
+
+void IdleStats::input(uint8_t source, uint32_t now_us)
+{
+    if (asleep && input_source < 0 && source < IDLE_SOURCES) {
+        input_at = now_us;
+        input_source = (int8_t)source;
+    }
+}
+
+uint64_t IdleStats::idle_micros() const
+{
+    return idle_us;
+}
+
+uint64_t IdleStats::active_micros(uint32_t now_us) const
+{
+    return asleep ? active_us : active_us + (now_us - changed_at);
+}
+
+uint32_t IdleStats::sleep_count() const
+{
+    return sleeps;
+}
+
+uint32_t IdleStats::woken_by_input() const
+{
+    return woken_input;
+}
+
+uint32_t IdleStats::woken_by_task() const
+{
+    return woken_task;
+}
+
+const LatencyHistogram& IdleStats::wake_latency_of(uint8_t source) const
+{
+    return wake_latency[source];
+}
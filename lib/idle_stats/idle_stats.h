@@ -0,0 +1,100 @@
+/**
+ * Author: Malav Patel
+ * Description: Purpose of this file is to define a helper class IdleStats
+ * that accounts for the time the main loop spends waiting against working,
+ * and for how long an input waits for the device to wake up.
+ */
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "latency_stats.h"
+
+// Inputs are told apart by a source number below this
+#define IDLE_SOURCES 4
+
+/**
+ * A helper class IdleStats is told when the main loop starts and stops
+ * waiting, and by the interrupt handlers when an input arrives. The first
+ * input of a wait woke it, the time from the interrupt to the end of the wait
+ * is the latency the wait added to that input. An input that arrives while
+ * the loop works is handled on its next iteration and adds nothing.
+ *
+ * Times are micros(), every stretch of waiting or working has to be shorter
+ * than the time it takes micros() to wrap.
+ */
+class IdleStats {
+    uint64_t idle_us;
+    uint64_t active_us;
+    uint32_t changed_at;
+
+    uint32_t sleeps;
+    uint32_t woken_input;
+    uint32_t woken_task;
+
+    // Shared with the interrupt handlers
+    std::atomic<bool> asleep;
+    std::atomic<int8_t> input_source;
+    std::atomic<uint32_t> input_at;
+
+    LatencyHistogram wake_latency[IDLE_SOURCES];
+
+public:
+    IdleStats();
+
+    /**
+     * Description: Start the accounting.
+     * Pre: None
+     * Post: The time from now counts as active.
+     */
+    void start(uint32_t now_us);
+
+    /**
+     * Description: The main loop starts waiting.
+     * Pre: None
+     * Post: The time from now counts as idle.
+     */
+    void sleep_begin(uint32_t now_us);
+
+    /**
+     * Description: The main loop stopped waiting.
+     * Pre: sleep_begin() was called. woken is true if the wait was cut short.
+     * Post: The time from now counts as active, the wake latency of the input
+     * that woke it is recorded.
+     */
+    void sleep_end(uint32_t now_us, bool woken);
+
+    /**
+     * Description: An input arrived, called from its interrupt handler.
+     * Pre: source < IDLE_SOURCES
+     * Post: If the loop is waiting and no input woke it yet, this one did.
+     */
+    void input(uint8_t source, uint32_t now_us);
+
+    /**
+     * Description: Time spent waiting and working since start().
+     * Pre: None
+     * Post: Returns microseconds.
+     */
+    uint64_t idle_micros() const;
+    uint64_t active_micros(uint32_t now_us) const;
+
+    /**
+     * Description: Counters of waits, and of the waits that were cut short by
+     * an input or by another task.
+     * Pre: None
+     * Post: Returns the count since start().
+     */
+    uint32_t sleep_count() const;
+    uint32_t woken_by_input() const;
+    uint32_t woken_by_task() const;
+
+    /**
+     * Description: Microseconds from an input that woke the loop until it was
+     * running again.
+     * Pre: source < IDLE_SOURCES
+     * Post: Returns the histogram.
+     */
+    const LatencyHistogram& wake_latency_of(uint8_t source) const;
+};
@@ -0,0 +1,112 @@
+/**
+ * Author: Malav Patel
+ * Description: Purpose of this file is to implement the copy of the keys
+ * defined in key_store.h
+ *
+ * The record is the version, the AtSign and every key as a length prefixed
+ * name and value, followed by a checksum of all of it. Lengths are 2 bytes
+ * little endian.
+ */
+#include "key_store.h"
+
+#include <cstdint>
+#include <cstring>
+
+#include "hal.h"
+
+// Name of the record in flash
+static const char RECORD_NAME[] = "keys";
+
+// FNV-1a over the record without its checksum
+static uint32_t checksum(const uint8_t* bytes, size_t size)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static bool put_string(std::string& record, const char* text, size_t length)
+{
+    if (length > 0xffff) {
+        return false;
+    }
+    record += (char)(length & 0xff);
+    record += (char)(length >> 8);
+    record.append(text, length);
+    return true;
+}
+
+// Reads a length prefixed string at offset, moving offset past it
+static bool get_string(const uint8_t* bytes, size_t size, size_t& offset, std::string& text)
+{
+    if (offset + 2 > size) {
+        return false;
+    }
+    size_t length = bytes[offset] | (size_t)bytes[offset + 1] << 8;
+    offset += 2;
+    if (offset + length > size) {
+        return false;
+    }
+    text.assign((const char*)bytes + offset, length);
+    offset += length;
+    return true;
+}
+
+bool key_store_load(const char* atsign, KeyMap& keys)
+{
+    keys.clear();
+    size_t size = flash_size(RECORD_NAME);
+    if (size < 8 || size > KEY_STORE_MAX_BYTES) {
+        return false;
+    }
+
+    // Only needed while booting, so it is not kept in static memory
+    std::string record(size, '\0');
+    const uint8_t* bytes = (const uint8_t*)record.data();
+    if (!flash_read(RECORD_NAME, &record[0], size)) {
+        return false;
+    }
+    size_t body = size - 4;
+    uint32_t stored = bytes[body] | (uint32_t)bytes[body + 1] << 8
+        | (uint32_t)bytes[body + 2] << 16 | (uint32_t)bytes[body + 3] << 24;
+    if (stored != checksum(bytes, body) || bytes[0] != KEY_STORE_VERSION) {
+        return false;
+    }
+
+    size_t offset = 1;
+    std::string name;
+    std::string value;
+    if (!get_string(bytes, body, offset, name) || name != atsign) {
+        return false;
+    }
+    while (offset < body) {
+        if (!get_string(bytes, body, offset, name) || !get_string(bytes, body, offset, value)) {
+            keys.clear();
+            return false;
+        }
+        keys[name] = value;
+    }
+    return !keys.empty();
+}
+
+bool key_store_save(const char* atsign, const KeyMap& keys)
+{
+    std::string record;
+    record += (char)KEY_STORE_VERSION;
+    bool ok = put_string(record, atsign, strlen(atsign));
+    for (const auto& key : keys) {
+        ok = ok && put_string(record, key.first.data(), key.first.size())
+            && put_string(record, key.second.data(), key.second.size());
+    }
+    if (!ok || record.size() + 4 > KEY_STORE_MAX_BYTES) {
+        return false;
+    }
+
+    uint32_t hash = checksum((const uint8_t*)record.data(), record.size());
+    for (int i = 0; i < 4; i++) {
+        record += (char)(hash >> (8 * i));
+    }
+    return flash_write(RECORD_NAME, record.data(), record.size());
+}
@@ -0,0 +1,35 @@
+/**
+ * Author: Malav Patel
+ * Description: Purpose of this file is to define a copy of the keys of the
+ * AtSign kept in flash in the form AtClient takes them, so a reboot does not
+ * have to read and parse the keys file again.
+ */
+#pragma once
+#include <string>
+#include <unordered_map>
+
+// Largest copy of the keys that is kept, a bigger one is read from the file
+#define KEY_STORE_MAX_BYTES 8192
+// Version of the layout, a copy of another version is ignored
+#define KEY_STORE_VERSION 1
+
+/**
+ * The keys as keys_reader::read_keys() returns them, name to base64 value.
+ */
+typedef std::unordered_map<std::string, std::string> KeyMap;
+
+/**
+ * Description: Read the copy of the keys of an AtSign.
+ * Pre: None
+ * Post: Returns true and fills keys if a copy for atsign with a valid
+ * checksum was found, otherwise keys is left empty.
+ */
+bool key_store_load(const char* atsign, KeyMap& keys);
+
+/**
+ * Description: Keep a copy of the keys of an AtSign, replacing the last one.
+ * Pre: keys were read from the keys file of atsign.
+ * Post: Returns false if they do not fit in KEY_STORE_MAX_BYTES or could not
+ * be written.
+ */
+bool key_store_save(const char* atsign, const KeyMap& keys);
@@ -0,0 +1,68 @@
+/**
+ * Author: Malav Patel
+ * Description: Purpose of this file is to implement the
+ * LatencyHistogram Class defined in latency_stats.h
+ */
+#include "latency_stats.h"
+
+LatencyHistogram::LatencyHistogram()
+{
+    reset();
+}
+
+void LatencyHistogram::record(uint32_t us)
+{
+    size_t bucket = 0;
+    while (bucket < LATENCY_BUCKETS - 1 && us >= ((uint32_t)1 << bucket)) {
+        bucket++;
+    }
+    buckets[bucket]++;
+    samples++;
+    total += us;
+    if (us > worst) {
+        worst = us;
+    }
+}
+
+uint32_t LatencyHistogram::percentile(unsigned percent) const
+{
+    if (samples == 0) {
+        return 0;
+    }
+
+    uint64_t wanted = ((uint64_t)samples * percent + 99) / 100;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < LATENCY_BUCKETS; i++) {
+        seen += buckets[i];
+        if (seen >= wanted && seen > 0) {
+            uint32_t bound = i == LATENCY_BUCKETS - 1 ? worst : ((uint32_t)1 << i);
+            return bound < worst ? bound : worst;
+        }
+    }
+    return worst;
+}
+
+uint32_t LatencyHistogram::count() const
+{
+    return samples;
+}
+
+uint32_t LatencyHistogram::max() const
+{
+    return worst;
+}
+
+uint32_t LatencyHistogram::mean() const
+{
+    return samples == 0 ? 0 : (uint32_t)(total / samples);
+}
+
+void LatencyHistogram::reset()
+{
+    for (size_t i = 0; i < LATENCY_BUCKETS; i++) {
+        buckets[i] = 0;
+    }
+    samples = 0;
+    worst = 0;
+    total = 0;
+}
@@ -0,0 +1,53 @@
+/**
+ * Author: Malav Patel
+ * Description: Purpose of this file is to define a helper class
+ * LatencyHistogram that records how long something took without
+ * allocating or keeping every sample.
+ */
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Bucket i counts samples below 2^i microseconds, the last one the rest
+#define LATENCY_BUCKETS 24
+
+/**
+ * A helper class LatencyHistogram keeps a count of samples per power of two
+ * of microseconds, along with the count, total and worst sample, so that
+ * percentiles can be estimated at any time in constant memory.
+ */
+class LatencyHistogram {
+    uint32_t buckets[LATENCY_BUCKETS];
+    uint32_t samples;
+    uint32_t worst;
+    uint64_t total;
+
+public:
+    LatencyHistogram();
+
+    /**
+     * Description: Record one sample.
+     * Pre: None
+     * Post: The sample is counted in its bucket.
+     */
+    void record(uint32_t us);
+
+    /**
+     * Description: Estimate a percentile of the samples.
+     * Pre: percent is between 0 and 100.
+     * Post: Returns the upper bound in microseconds of the bucket the
+     * percentile falls in, capped at the worst sample.
+     */
+    uint32_t percentile(unsigned percent) const;
+
+    uint32_t count() const;
+    uint32_t max() const;
+    uint32_t mean() const;
+
+    /**
+     * Description: Forget every sample.
+     * Pre: None
+     * Post: The histogram is empty.
+     */
+    void reset();
+};
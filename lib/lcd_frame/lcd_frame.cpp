@@ -0,0 +1,124 @@
+/**
+ * Author: Malav Patel
+ * Description: Purpose of this file is to implement the
+ * LcdFrame Class defined in lcd_frame.h
+ */
+#include "lcd_frame.h"
+
+#include <climits>
+
+LcdFrame::LcdFrame()
+    : dirty(false)
+    , last_flush(0)
+    , flushes(0)
+    , cells_sent(0)
+    , cells_skipped(0)
+{
+    for (uint8_t r = 0; r < LCD_FRAME_ROWS; r++) {
+        for (uint8_t c = 0; c < LCD_FRAME_COLS; c++) {
+            shown[r][c] = ' ';
+            drawn[r][c] = ' ';
+        }
+    }
+}
+
+void LcdFrame::write(uint8_t row, uint8_t col, const char* text)
+{
+    if (row >= LCD_FRAME_ROWS) {
+        return;
+    }
+    for (; col < LCD_FRAME_COLS && *text != '\0'; col++, text++) {
+        if (drawn[row][col] != *text) {
+            drawn[row][col] = *text;
+            dirty = true;
+        }
+    }
+}
+
+void LcdFrame::write_number(uint8_t row, uint8_t col, uint8_t width, int value)
+{
+    // Longest int is 11 characters with its sign
+    char text[12];
+    char digits[12];
+    size_t length = 0;
+
+    unsigned int magnitude = value < 0 ? 0u - (unsigned int)value : (unsigned int)value;
+    do {
+        digits[length++] = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude > 0);
+    if (value < 0) {
+        digits[length++] = '-';
+    }
+
+    if (width >= sizeof(text)) {
+        width = sizeof(text) - 1;
+    }
+    for (size_t i = 0; i < width; i++) {
+        if (length > width) {
+            text[i] = '#';
+        } else {
+            text[i] = i < width - length ? ' ' : digits[width - 1 - i];
+        }
+    }
+    text[width] = '\0';
+    write(row, col, text);
+}
+
+bool LcdFrame::flush_due(unsigned long now, unsigned long interval) const
+{
+    return dirty && now - last_flush >= interval;
+}
+
+unsigned long LcdFrame::flush_in(unsigned long now, unsigned long interval) const
+{
+    if (!dirty) {
+        return ULONG_MAX;
+    }
+    unsigned long since = now - last_flush;
+    return since >= interval ? 0 : interval - since;
+}
+
+void LcdFrame::flush(LiquidCrystal& lcd, unsigned long now)
+{
+    last_flush = now;
+    if (!dirty) {
+        return;
+    }
+    dirty = false;
+    flushes++;
+
+    for (uint8_t r = 0; r < LCD_FRAME_ROWS; r++) {
+        // Column the display writes the next character to, past the end
+        // of the row when the cursor has to be moved first
+        uint8_t cursor = LCD_FRAME_COLS;
+        for (uint8_t c = 0; c < LCD_FRAME_COLS; c++) {
+            if (shown[r][c] == drawn[r][c]) {
+                cells_skipped++;
+                continue;
+            }
+            if (cursor != c) {
+                lcd.setCursor(c, r);
+            }
+            lcd.write((uint8_t)drawn[r][c]);
+            shown[r][c] = drawn[r][c];
+            cursor = c + 1;
+            cells_sent++;
+        }
+    }
+}
+
+uint32_t LcdFrame::flush_count() const
+{
+    return flushes;
+}
+
+uint32_t LcdFrame::sent_count() const
+{
+    return cells_sent;
+}
+
+uint32_t LcdFrame::skipped_count() const
+{
+    return cells_skipped;
+}
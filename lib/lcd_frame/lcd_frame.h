@@ -0,0 +1,86 @@
+/**
+ * Author: Malav Patel
+ * Description: Purpose of this file is to define a helper class
+ * LcdFrame that keeps a shadow copy of the character LCD so that only the
+ * cells that changed are sent over its slow 4-bit bus.
+ */
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+#include "hal.h"
+
+// Size of the display the frame mirrors
+#define LCD_FRAME_COLS 8
+#define LCD_FRAME_ROWS 2
+
+/**
+ * A helper class LcdFrame holds two copies of the display: what it shows and
+ * what it should show. The event handlers draw into the second one, which
+ * never touches the bus and never allocates. flush() then compares the two and
+ * writes only the cells that differ, moving the cursor only when the next
+ * changed cell is not where the display would put the next character anyway.
+ * Drawing several times between two flushes costs one bus transaction.
+ */
+class LcdFrame {
+    char shown[LCD_FRAME_ROWS][LCD_FRAME_COLS];
+    char drawn[LCD_FRAME_ROWS][LCD_FRAME_COLS];
+    bool dirty;
+    unsigned long last_flush;
+
+    uint32_t flushes;
+    uint32_t cells_sent;
+    uint32_t cells_skipped;
+
+public:
+    LcdFrame();
+
+    /**
+     * Description: Draw text starting at a cell, cut off at the end of the row.
+     * Pre: None
+     * Post: The cells are shown with the next flush().
+     */
+    void write(uint8_t row, uint8_t col, const char* text);
+
+    /**
+     * Description: Draw value right aligned in width cells starting at col,
+     * padded with spaces.
+     * Pre: None
+     * Post: The cells are shown with the next flush(), a value that does not
+     * fit is shown as #.
+     */
+    void write_number(uint8_t row, uint8_t col, uint8_t width, int value);
+
+    /**
+     * Description: Checks if something was drawn that is not shown yet and
+     * the last flush was at least interval milliseconds ago.
+     * Pre: None
+     * Post: Returns true if flush() should be called.
+     */
+    bool flush_due(unsigned long now, unsigned long interval) const;
+
+    /**
+     * Description: Time until flush_due() becomes true.
+     * Pre: None
+     * Post: Returns milliseconds, 0 if a flush is due already and ULONG_MAX
+     * if nothing was drawn since the last flush.
+     */
+    unsigned long flush_in(unsigned long now, unsigned long interval) const;
+
+    /**
+     * Description: Send the cells that differ from what the display shows.
+     * Pre: lcd.begin() has been called, which clears the display.
+     * Post: The display shows the drawn frame.
+     */
+    void flush(LiquidCrystal& lcd, unsigned long now);
+
+    /**
+     * Description: Counters of flushes that sent something, and of the cells
+     * that were sent or did not need to be because they had not changed.
+     * Pre: None
+     * Post: Returns the count since boot.
+     */
+    uint32_t flush_count() const;
+    uint32_t sent_count() const;
+    uint32_t skipped_count() const;
+};
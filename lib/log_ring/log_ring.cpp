@@ -0,0 +1,76 @@
+/**
+ * Author: Malav Patel
+ * Description: Purpose of this file is to implement the
+ * LogRing Class defined in log_ring.h
+ */
+#include "log_ring.h"
+
+static_assert((LOG_RING_SIZE & (LOG_RING_SIZE - 1)) == 0, "LOG_RING_SIZE must be a power of two");
+static_assert(sizeof(LogRecord) == 16, "LogRecord should stay 16 bytes");
+
+LogRing::LogRing()
+    : head(0)
+    , tail(0)
+    , written(0)
+    , dropped(0)
+    , high_water(0)
+    , clock(nullptr)
+{
+}
+
+void LogRing::set_clock(unsigned long (*clock)())
+{
+    this->clock = clock;
+}
+
+void LogRing::add(uint8_t level, uint16_t id, int32_t a, int32_t b)
+{
+    uint32_t depth = head - tail;
+    if (depth == LOG_RING_SIZE) {
+        dropped++;
+        return;
+    }
+
+    LogRecord& record = records[head & (LOG_RING_SIZE - 1)];
+    record.at = clock == nullptr ? 0 : (uint32_t)clock();
+    record.id = id;
+    record.level = level;
+    record.a = a;
+    record.b = b;
+    head++;
+    written++;
+
+    if (depth + 1 > high_water) {
+        high_water = depth + 1;
+    }
+}
+
+bool LogRing::take(LogRecord& record)
+{
+    if (head == tail) {
+        return false;
+    }
+    record = records[tail & (LOG_RING_SIZE - 1)];
+    tail++;
+    return true;
+}
+
+bool LogRing::empty() const
+{
+    return head == tail;
+}
+
+uint32_t LogRing::written_count() const
+{
+    return written;
+}
+
+uint32_t LogRing::dropped_count() const
+{
+    return dropped;
+}
+
+uint32_t LogRing::high_water_mark() const
+{
+    return high_water;
+}
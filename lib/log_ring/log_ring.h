@@ -0,0 +1,102 @@
+/**
+ * Author: Malav Patel
+ * Description: Purpose of this file is to define a helper class LogRing
+ * that keeps log records in binary until the main loop has time to print
+ * them.
+ */
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Records the ring holds, a power of two
+#define LOG_RING_SIZE 64
+
+// Levels of a record, a record is kept if its level is at most LOG_LEVEL
+#define LOG_LEVEL_ERROR 0
+#define LOG_LEVEL_WARN 1
+#define LOG_LEVEL_INFO 2
+#define LOG_LEVEL_DEBUG 3
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+/**
+ * Add a record to a LogRing. The level is a constant, so a record above
+ * LOG_LEVEL is compiled out together with the evaluation of its fields.
+ */
+#define LOG_RECORD(ring, level, id, a, b)          \
+    do {                                           \
+        if ((level) <= LOG_LEVEL) {                \
+            (ring).add((level), (id), (a), (b));   \
+        }                                          \
+    } while (0)
+
+/**
+ * One record: when it was added, what happened and two numbers that go with
+ * it. The text is only looked up by the id when the record is printed.
+ */
+struct LogRecord {
+    uint32_t at;
+    uint16_t id;
+    uint8_t level;
+    int32_t a;
+    int32_t b;
+};
+
+/**
+ * A helper class LogRing is a fixed ring of LogRecord. Adding a record
+ * copies 16 bytes and never blocks or allocates; when the ring is full the
+ * new record is dropped and counted, so what was logged before a burst is
+ * kept. The records are taken out oldest first by the code that prints them.
+ *
+ * Records are added and taken by the main loop only.
+ */
+class LogRing {
+    LogRecord records[LOG_RING_SIZE];
+    uint32_t head;
+    uint32_t tail;
+
+    uint32_t written;
+    uint32_t dropped;
+    uint32_t high_water;
+
+    unsigned long (*clock)();
+
+public:
+    LogRing();
+
+    /**
+     * Description: Set the clock every record is stamped with.
+     * Pre: Called during setup.
+     * Post: Records added from now carry the reading of clock.
+     */
+    void set_clock(unsigned long (*clock)());
+
+    /**
+     * Description: Add a record, usually through LOG_RECORD.
+     * Pre: None
+     * Post: The record is in the ring, or counted as dropped if it was full.
+     */
+    void add(uint8_t level, uint16_t id, int32_t a, int32_t b);
+
+    /**
+     * Description: Take the oldest record.
+     * Pre: None
+     * Post: Returns false if the ring is empty, otherwise the record is
+     * copied to record and removed.
+     */
+    bool take(LogRecord& record);
+
+    bool empty() const;
+
+    /**
+     * Description: Counters of records added and dropped, and the most
+     * records that were waiting at once.
+     * Pre: None
+     * Post: Returns the count since boot.
+     */
+    uint32_t written_count() const;
+    uint32_t dropped_count() const;
+    uint32_t high_water_mark() const;
+};
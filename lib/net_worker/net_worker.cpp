@@ -0,0 +1,442 @@
+/**
+ * Author: Malav Patel
+ * Description: Purpose of this file is to implement the
+ * NetWorker Class defined in net_worker.h
+ */
+#include "net_worker.h"
+
+#include <climits>
+#include <cstring>
+#include <string>
+
+NetWorker::NetWorker()
+    : client(nullptr)
+    , ssid(nullptr)
+    , password(nullptr)
+    , on_complete(nullptr)
+    , dropped(0)
+    , performed(0)
+    , holding(false)
+    , holds(0)
+    , link(true)
+    , lost_at(0)
+    , retry_at(0)
+    , backoff(NET_BACKOFF_MIN_MS)
+    , disconnects(0)
+    , attempts(0)
+#ifdef ARDUINO
+    , task(nullptr)
+#elif defined(SIM_DETERMINISTIC)
+    , busy(false)
+    , connecting(false)
+    , done_at(0)
+#else
+    , notified(false)
+    , running(false)
+#endif
+{
+}
+
+NetWorker::~NetWorker()
+{
+    stop();
+}
+
+#ifdef ARDUINO
+
+void NetWorker::task_entry(void* self)
+{
+    static_cast<NetWorker*>(self)->run();
+}
+
+void NetWorker::start(AtClient* client, const char* ssid, const char* password, void (*on_complete)())
+{
+    this->client = client;
+    this->ssid = ssid;
+    this->password = password;
+    this->on_complete = on_complete;
+    xTaskCreatePinnedToCore(task_entry, "net_worker", NET_TASK_STACK, this, 1, &task, NET_TASK_CORE);
+}
+
+void NetWorker::stop()
+{
+}
+
+void NetWorker::notify()
+{
+    if (task != nullptr) {
+        xTaskNotifyGive(task);
+    }
+}
+
+void NetWorker::wait(unsigned long ms)
+{
+    ulTaskNotifyTake(pdTRUE, ms == ULONG_MAX ? portMAX_DELAY : pdMS_TO_TICKS(ms));
+}
+
+void NetWorker::run()
+{
+    for (;;) {
+        wait(wait_ms());
+        if (!link && retry_in() == 0) {
+            reconnect();
+        }
+        const NetRequest* request;
+        while (hand_over() && (request = requests.peek()) != nullptr) {
+            NetRequest copy = *request;
+            requests.pop();
+            perform(copy);
+        }
+    }
+}
+
+#elif defined(SIM_DETERMINISTIC)
+
+void NetWorker::step(void* self)
+{
+    static_cast<NetWorker*>(self)->run();
+}
+
+void NetWorker::start(AtClient* client, const char* ssid, const char* password, void (*on_complete)())
+{
+    this->client = client;
+    this->ssid = ssid;
+    this->password = password;
+    this->on_complete = on_complete;
+    hal_sim::add_task(step, this);
+}
+
+void NetWorker::stop()
+{
+}
+
+void NetWorker::notify()
+{
+}
+
+void NetWorker::wait(unsigned long ms)
+{
+    (void)ms;
+}
+
+// Performs the request in flight once its latency has passed, then takes
+// the next one. Requests are still performed one at a time and in order,
+// none is taken while a completion is held.
+// An attempt to connect again holds up the requests like a request would,
+// while the link is down requests fail without waiting.
+void NetWorker::run()
+{
+    for (;;) {
+        if (busy || connecting) {
+            if ((long)(millis() - done_at) < 0) {
+                return;
+            }
+            if (busy) {
+                busy = false;
+                perform(in_flight);
+            } else {
+                connecting = false;
+                reconnect();
+            }
+            continue;
+        }
+
+        if (!hand_over()) {
+            return;
+        }
+
+        if (!link && retry_in() == 0) {
+            connecting = true;
+            done_at = millis() + NET_SIM_CONNECT_ROUND_TRIPS * hal_sim::network_latency_millis();
+            continue;
+        }
+
+        const NetRequest* request = requests.peek();
+        if (request == nullptr) {
+            return;
+        }
+        in_flight = *request;
+        requests.pop();
+        if (!link) {
+            perform(in_flight);
+            continue;
+        }
+        busy = true;
+        done_at = millis() + hal_sim::network_latency_millis();
+    }
+}
+
+#else
+
+void NetWorker::start(AtClient* client, const char* ssid, const char* password, void (*on_complete)())
+{
+    this->client = client;
+    this->ssid = ssid;
+    this->password = password;
+    this->on_complete = on_complete;
+    running = true;
+    thread = std::thread(&NetWorker::run, this);
+}
+
+void NetWorker::stop()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        running = false;
+        notified = true;
+    }
+    wake.notify_one();
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+void NetWorker::notify()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        notified = true;
+    }
+    wake.notify_one();
+}
+
+void NetWorker::wait(unsigned long ms)
+{
+    std::unique_lock<std::mutex> guard(lock);
+    if (ms == ULONG_MAX) {
+        wake.wait(guard, [this] { return notified; });
+    } else {
+        wake.wait_for(guard, std::chrono::milliseconds(ms), [this] { return notified; });
+    }
+    notified = false;
+}
+
+void NetWorker::run()
+{
+    for (;;) {
+        wait(wait_ms());
+        if (!link && retry_in() == 0) {
+            reconnect();
+        }
+        const NetRequest* request;
+        while (hand_over() && (request = requests.peek()) != nullptr) {
+            NetRequest copy = *request;
+            requests.pop();
+            perform(copy);
+        }
+        std::lock_guard<std::mutex> guard(lock);
+        if (!running) {
+            return;
+        }
+    }
+}
+
+#endif
+
+void NetWorker::perform(const NetRequest& request)
+{
+    NetCompletion completion;
+    completion.op = request.op;
+    completion.key = request.key;
+    completion.ok = true;
+    completion.unchanged = false;
+    completion.version = 0;
+    completion.value[0] = '\0';
+
+    if (request.op == NetOp::put) {
+        memcpy(completion.value, request.value, sizeof(completion.value));
+    }
+
+    if (!link) {
+        // Fail right away, the value is written once the link is back
+        completion.ok = false;
+    } else if (request.op == NetOp::put) {
+        client->put_ak(*request.key, request.value);
+        completion.ok = net_link_up();
+        performed.fetch_add(1, std::memory_order_relaxed);
+    } else if (request.op == NetOp::get_changed && net_key_version(client, request.key, completion.version)
+        && completion.version == request.version) {
+        // Not updated since the last read, the value is not read again
+        completion.unchanged = true;
+        performed.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        std::string value = client->get_ak(*request.key);
+        if (!net_link_up() || value.size() >= NET_VALUE_MAX) {
+            completion.ok = false;
+        } else {
+            memcpy(completion.value, value.c_str(), value.size() + 1);
+        }
+        performed.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    if (link && !net_link_up()) {
+        link_lost();
+    }
+
+    if (!completions.push(completion)) {
+        // The main loop is behind, keep the completion until there is room
+        held = completion;
+        holding = true;
+        holds.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (on_complete != nullptr) {
+        on_complete();
+    }
+}
+
+// Returns true once no completion is held
+bool NetWorker::hand_over()
+{
+    if (!holding) {
+        return true;
+    }
+    if (!completions.push(held)) {
+        return false;
+    }
+    holding = false;
+    if (on_complete != nullptr) {
+        on_complete();
+    }
+    return true;
+}
+
+// How long the task can wait before it has something to do by itself
+unsigned long NetWorker::wait_ms() const
+{
+    if (holding) {
+        return NET_HAND_OVER_RETRY_MS;
+    }
+    return link ? ULONG_MAX : retry_in();
+}
+
+void NetWorker::link_lost()
+{
+    link = false;
+    disconnects.fetch_add(1, std::memory_order_relaxed);
+    lost_at = millis();
+    backoff = NET_BACKOFF_MIN_MS;
+    retry_at = lost_at + backoff;
+}
+
+void NetWorker::reconnect()
+{
+    attempts.fetch_add(1, std::memory_order_relaxed);
+    if (!net_link_connect(client, ssid, password)) {
+        backoff = backoff * 2 < NET_BACKOFF_MAX_MS ? backoff * 2 : NET_BACKOFF_MAX_MS;
+        retry_at = millis() + backoff;
+        return;
+    }
+
+    reconnect_time.record((uint32_t)(millis() - lost_at));
+    link = true;
+    // Let the main loop write what it kept while the link was down
+    if (on_complete != nullptr) {
+        on_complete();
+    }
+}
+
+unsigned long NetWorker::retry_in() const
+{
+    long left = (long)(retry_at - millis());
+    return left > 0 ? (unsigned long)left : 0;
+}
+
+bool NetWorker::post_put(const AtKey* key, const char* value)
+{
+    NetRequest request;
+    request.op = NetOp::put;
+    request.key = key;
+    request.version = 0;
+
+    size_t length = strlen(value);
+    if (length >= NET_VALUE_MAX) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    memcpy(request.value, value, length + 1);
+
+    if (!requests.push(request)) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    notify();
+    return true;
+}
+
+bool NetWorker::post_get(const AtKey* key)
+{
+    NetRequest request;
+    request.op = NetOp::get;
+    request.key = key;
+    request.version = 0;
+    request.value[0] = '\0';
+
+    if (!requests.push(request)) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    notify();
+    return true;
+}
+
+bool NetWorker::post_get_changed(const AtKey* key, uint32_t version)
+{
+    NetRequest request;
+    request.op = NetOp::get_changed;
+    request.key = key;
+    request.version = version;
+    request.value[0] = '\0';
+
+    if (!requests.push(request)) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    notify();
+    return true;
+}
+
+bool NetWorker::take_completion(NetCompletion& completion)
+{
+    const NetCompletion* next = completions.peek();
+    if (next == nullptr) {
+        return false;
+    }
+    completion = *next;
+    completions.pop();
+    return true;
+}
+
+uint32_t NetWorker::request_dropped_count() const
+{
+    return dropped.load(std::memory_order_relaxed);
+}
+
+uint32_t NetWorker::completion_held_count() const
+{
+    return holds.load(std::memory_order_relaxed);
+}
+
+uint32_t NetWorker::performed_count() const
+{
+    return performed.load(std::memory_order_relaxed);
+}
+
+bool NetWorker::connected() const
+{
+    return link;
+}
+
+uint32_t NetWorker::disconnect_count() const
+{
+    return disconnects.load(std::memory_order_relaxed);
+}
+
+uint32_t NetWorker::reconnect_attempt_count() const
+{
+    return attempts.load(std::memory_order_relaxed);
+}
+
+const LatencyHistogram& NetWorker::reconnect_millis() const
+{
+    return reconnect_time;
+}
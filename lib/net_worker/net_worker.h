@@ -0,0 +1,249 @@
+/**
+ * Author: Malav Patel
+ * Description: Purpose of this file is to define a helper class
+ * NetWorker that owns the AtClient and performs every request to the
+ * AtSign secondary server away from the main loop.
+ */
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+#include "event_bus.h"
+#include "hal.h"
+#include "latency_stats.h"
+
+#ifdef ARDUINO
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#elif !defined(SIM_DETERMINISTIC)
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
+
+// Longest value that can be put or read with a NetWorker request
+#define NET_VALUE_MAX 64
+// Number of requests and completions that can be waiting at once
+#define NET_QUEUE_SIZE 32
+// The ESP32 core the network task is pinned to, the Arduino loop runs on core 1
+#define NET_TASK_CORE 0
+#define NET_TASK_STACK 8192
+// Wait before the first attempt to connect again once the link is lost,
+// doubled after every attempt that fails up to NET_BACKOFF_MAX_MS
+#define NET_BACKOFF_MIN_MS 500
+#define NET_BACKOFF_MAX_MS 16000
+// Round trips of network latency an attempt to connect takes in the simulator
+#define NET_SIM_CONNECT_ROUND_TRIPS 3
+// Wait before handing over a completion again that found the completions full
+#define NET_HAND_OVER_RETRY_MS 5
+
+/**
+ * The operations NetWorker can perform.
+ */
+enum NetOp {
+    // put_ak of a value
+    put,
+    // get_ak of a value
+    get,
+    // get_ak of a value whose version is not the one the caller read last
+    get_changed
+};
+
+/**
+ * A request posted by the main loop to NetWorker.
+ */
+struct NetRequest {
+    NetOp op;
+    const AtKey* key;
+    uint32_t version;
+    char value[NET_VALUE_MAX];
+};
+
+/**
+ * The result of a NetRequest, handed back to the main loop.
+ * For a get the value holds what was read from the server, for a put
+ * the value that was written. For a get_changed the version is the one the
+ * server gave the key, 0 if it could not be looked up, and unchanged is true
+ * when it was the version of the request so the value was not read.
+ */
+struct NetCompletion {
+    NetOp op;
+    const AtKey* key;
+    bool ok;
+    bool unchanged;
+    uint32_t version;
+    char value[NET_VALUE_MAX];
+};
+
+/**
+ * A helper class NetWorker runs a task (pinned to the other core on ESP32,
+ * a std::thread on the native build) that owns the AtClient. The main loop
+ * posts requests without waiting, the task performs them one at a time and
+ * pushes a NetCompletion back, calling on_complete so the main loop can be
+ * told with an event. The latency of the network never reaches the main loop.
+ *
+ * A request that finds the link down fails, and a failed request takes the
+ * link down. The task then connects again by itself, waiting
+ * NET_BACKOFF_MIN_MS before the first attempt and twice as long after every
+ * attempt that fails. Until it is back, requests fail right away without
+ * touching the network; the caller keeps what it could not write and writes
+ * it once connected() is true again, on_complete is called then too.
+ *
+ * A completion is never dropped: when the main loop has not taken the ones
+ * before it and there is no room, the task keeps it and takes no other
+ * request until it could hand it over. The requests wait in their queue
+ * meanwhile, and a post that finds the queue full fails and is counted.
+ *
+ * A get_changed costs a metadata lookup instead of reading and decrypting
+ * the value when the key was not updated. Where the client can not look up
+ * metadata (net_key_version()) it reads the value every time.
+ *
+ * When built with SIM_DETERMINISTIC there is no thread, the host simulator
+ * steps the worker with hal_sim::run_tasks() and every request completes
+ * after hal_sim::network_latency_millis() of virtual time.
+ */
+class NetWorker {
+    AtClient* client;
+    const char* ssid;
+    const char* password;
+    void (*on_complete)();
+
+    EventRing<NetRequest, NET_QUEUE_SIZE> requests;
+    EventRing<NetCompletion, NET_QUEUE_SIZE> completions;
+
+    std::atomic<uint32_t> dropped;
+    std::atomic<uint32_t> performed;
+
+    // A completion that did not fit, only used by the network task
+    NetCompletion held;
+    bool holding;
+    std::atomic<uint32_t> holds;
+
+    // State of the link, only changed by the network task
+    std::atomic<bool> link;
+    unsigned long lost_at;
+    unsigned long retry_at;
+    unsigned long backoff;
+    std::atomic<uint32_t> disconnects;
+    std::atomic<uint32_t> attempts;
+    LatencyHistogram reconnect_time;
+
+#ifdef ARDUINO
+    TaskHandle_t task;
+    static void task_entry(void* self);
+#elif defined(SIM_DETERMINISTIC)
+    NetRequest in_flight;
+    bool busy;
+    bool connecting;
+    unsigned long done_at;
+    static void step(void* self);
+#else
+    std::thread thread;
+    std::mutex lock;
+    std::condition_variable wake;
+    bool notified;
+    bool running;
+#endif
+
+    void notify();
+    void wait(unsigned long ms);
+    void run();
+    void perform(const NetRequest& request);
+    bool hand_over();
+    unsigned long wait_ms() const;
+    void link_lost();
+    void reconnect();
+    unsigned long retry_in() const;
+
+public:
+    NetWorker();
+    ~NetWorker();
+
+    /**
+     * Description: Start the network task with an authenticated client.
+     * Pre: client has been authenticated with ssid and password, which are
+     * kept to connect again. on_complete is safe to call from the network
+     * task (for example it only adds an event to an EventBus).
+     * Post: Requests posted from now on are performed by the network task.
+     */
+    void start(AtClient* client, const char* ssid, const char* password, void (*on_complete)());
+
+    /**
+     * Description: Stop the network task after the request it is performing.
+     * Pre: None
+     * Post: No more requests are performed. Only used on the native build.
+     */
+    void stop();
+
+    /**
+     * Description: Post a put_ak of value to key.
+     * Pre: None
+     * Post: Returns false and counts a drop if the request queue is full or
+     * the value is longer than NET_VALUE_MAX - 1.
+     */
+    bool post_put(const AtKey* key, const char* value);
+
+    /**
+     * Description: Post a get_ak of key.
+     * Pre: None
+     * Post: Returns false and counts a drop if the request queue is full.
+     */
+    bool post_get(const AtKey* key);
+
+    /**
+     * Description: Post a get_ak of key that looks up the version of the key
+     * first and only reads the value if it is not version, the version the
+     * last get_changed of key completed with.
+     * Pre: None
+     * Post: Returns false and counts a drop if the request queue is full.
+     */
+    bool post_get_changed(const AtKey* key, uint32_t version);
+
+    /**
+     * Description: Take the oldest completion. Main loop only.
+     * Pre: None
+     * Post: Returns false if no completion is waiting.
+     */
+    bool take_completion(NetCompletion& completion);
+
+    /**
+     * Description: Number of requests that could not be posted and were
+     * dropped, and of requests performed.
+     * Pre: None
+     * Post: Returns the count since boot.
+     */
+    uint32_t request_dropped_count() const;
+    uint32_t performed_count() const;
+
+    /**
+     * Description: Number of completions that found no room and were held
+     * by the network task until the main loop made room. None are dropped.
+     * Pre: None
+     * Post: Returns the count since boot.
+     */
+    uint32_t completion_held_count() const;
+
+    /**
+     * Description: Checks if the link to the secondary server is up.
+     * Pre: None
+     * Post: Returns false from a failed request until the task connected again.
+     */
+    bool connected() const;
+
+    /**
+     * Description: Counters of the times the link was lost and of the
+     * attempts to connect again.
+     * Pre: None
+     * Post: Returns the count since boot.
+     */
+    uint32_t disconnect_count() const;
+    uint32_t reconnect_attempt_count() const;
+
+    /**
+     * Description: Milliseconds from losing the link until it was back.
+     * Pre: None
+     * Post: Returns the histogram, written by the network task.
+     */
+    const LatencyHistogram& reconnect_millis() const;
+};
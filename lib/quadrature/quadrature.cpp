@@ -0,0 +1,61 @@
+/**
+ * Author: Malav Patel
+ * Description: Purpose of this file is to implement the
+ * QuadratureDecoder Class defined in quadrature.h
+ */
+#include "quadrature.h"
+
+// Indexed by (previous CLK, previous DAT, CLK, DAT). 0 for no change or for
+// a transition that skipped a state.
+static const int8_t TRANSITIONS[16] = {
+    0, -1, 1, 0,
+    1, 0, 0, -1,
+    -1, 0, 0, 1,
+    0, 1, -1, 0
+};
+
+// Transitions where both signals changed at once
+static const bool SKIPPED[16] = {
+    false, false, false, true,
+    false, false, true, false,
+    false, true, false, false,
+    true, false, false, false
+};
+
+QuadratureDecoder::QuadratureDecoder(uint8_t steps_per_detent)
+    : state(0x3)
+    , steps_per_detent(steps_per_detent == 0 ? 1 : steps_per_detent)
+    , steps(0)
+    , invalid(0)
+{
+}
+
+void QuadratureDecoder::update(bool clk, bool dat)
+{
+    uint8_t current = (clk ? 0x2 : 0) | (dat ? 0x1 : 0);
+    uint8_t index = (uint8_t)((state << 2) | current);
+    state = current;
+
+    if (SKIPPED[index]) {
+        invalid.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    if (TRANSITIONS[index] != 0) {
+        steps.fetch_add(TRANSITIONS[index], std::memory_order_relaxed);
+    }
+}
+
+int32_t QuadratureDecoder::take()
+{
+    int32_t counted = steps.load(std::memory_order_relaxed);
+    int32_t detents = counted / steps_per_detent;
+    if (detents != 0) {
+        steps.fetch_sub(detents * steps_per_detent, std::memory_order_relaxed);
+    }
+    return detents;
+}
+
+uint32_t QuadratureDecoder::invalid_count() const
+{
+    return invalid.load(std::memory_order_relaxed);
+}
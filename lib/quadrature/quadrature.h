@@ -0,0 +1,49 @@
+/**
+ * Author: Malav Patel
+ * Description: Purpose of this file is to define a helper class
+ * QuadratureDecoder that turns the CLK and DAT signals of the Rotary
+ * Encoder Module into a count of detents.
+ */
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+/**
+ * A helper class QuadratureDecoder keeps the last level of both encoder
+ * signals and looks every new pair of levels up in a transition table. Valid
+ * transitions count a quarter step up or down, invalid ones (contact bounce,
+ * a missed edge) count nothing, so no time based debounce is needed and fast
+ * spins are not lost. update() is meant to be called from the interrupt of
+ * either pin, take() from the main loop.
+ */
+class QuadratureDecoder {
+    uint8_t state;
+    uint8_t steps_per_detent;
+    std::atomic<int32_t> steps;
+    std::atomic<uint32_t> invalid;
+
+public:
+    explicit QuadratureDecoder(uint8_t steps_per_detent = 4);
+
+    /**
+     * Description: Feed the current level of both signals.
+     * Pre: Called on every change of either pin, safe from interrupts.
+     * Post: The step count moved by the transition from the last levels.
+     */
+    void update(bool clk, bool dat);
+
+    /**
+     * Description: Take the whole detents counted since the last call.
+     * Pre: Called from a single consumer.
+     * Post: Returns the net detents, positive when CLK leads DAT. Steps that
+     * do not make a whole detent yet are kept for the next call.
+     */
+    int32_t take();
+
+    /**
+     * Description: Number of transitions that skipped a state.
+     * Pre: None
+     * Post: Returns the count since boot.
+     */
+    uint32_t invalid_count() const;
+};
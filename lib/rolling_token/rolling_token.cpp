@@ -0,0 +1,115 @@
+/**
+ * Author: Malav Patel
+ * Description: Purpose of this file is to implement the
+ * RollingToken defined in rolling_token.h
+ */
+#include "rolling_token.h"
+
+static uint64_t load_le64(const char* bytes)
+{
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; i--) {
+        value = (value << 8) | (uint8_t)bytes[i];
+    }
+    return value;
+}
+
+static inline uint64_t rotl(uint64_t x, int b)
+{
+    return (x << b) | (x >> (64 - b));
+}
+
+static inline void sip_round(uint64_t& v0, uint64_t& v1, uint64_t& v2, uint64_t& v3)
+{
+    v0 += v1;
+    v1 = rotl(v1, 13);
+    v1 ^= v0;
+    v0 = rotl(v0, 32);
+    v2 += v3;
+    v3 = rotl(v3, 16);
+    v3 ^= v2;
+    v0 += v3;
+    v3 = rotl(v3, 21);
+    v3 ^= v0;
+    v2 += v1;
+    v1 = rotl(v1, 17);
+    v1 ^= v2;
+    v2 = rotl(v2, 32);
+}
+
+RollingToken::RollingToken(const char* key)
+    : k0(load_le64(key))
+    , k1(load_le64(key + 8))
+{
+}
+
+uint32_t RollingToken::at(uint32_t window) const
+{
+    // SipHash-2-4 of the window as one 8 byte little endian block
+    uint64_t v0 = k0 ^ 0x736f6d6570736575ULL;
+    uint64_t v1 = k1 ^ 0x646f72616e646f6dULL;
+    uint64_t v2 = k0 ^ 0x6c7967656e657261ULL;
+    uint64_t v3 = k1 ^ 0x7465646279746573ULL;
+
+    uint64_t message = window;
+    v3 ^= message;
+    sip_round(v0, v1, v2, v3);
+    sip_round(v0, v1, v2, v3);
+    v0 ^= message;
+
+    // Final block holds only the length of the message
+    uint64_t last = (uint64_t)8 << 56;
+    v3 ^= last;
+    sip_round(v0, v1, v2, v3);
+    sip_round(v0, v1, v2, v3);
+    v0 ^= last;
+
+    v2 ^= 0xff;
+    for (int i = 0; i < 4; i++) {
+        sip_round(v0, v1, v2, v3);
+    }
+    return (uint32_t)((v0 ^ v1 ^ v2 ^ v3) & 0x7fffffff);
+}
+
+bool RollingToken::verify(uint32_t token, uint32_t seconds) const
+{
+    uint32_t now = window(seconds);
+    bool valid = false;
+    // Every window is checked, so the time taken does not tell which matched
+    for (int offset = -ROLLING_TOKEN_SKEW; offset <= ROLLING_TOKEN_SKEW; offset++) {
+        valid |= at(now + (uint32_t)offset) == token;
+    }
+    return valid;
+}
+
+TokenReplayGuard::TokenReplayGuard()
+    : next(0)
+{
+    for (size_t i = 0; i < TOKEN_REPLAY_SLOTS; i++) {
+        seen[i].used = false;
+    }
+}
+
+bool TokenReplayGuard::take(uint32_t token, int32_t event, int32_t value, uint32_t seconds)
+{
+    // Longest a token is accepted for after it was first seen
+    const uint32_t remember = (2 * ROLLING_TOKEN_SKEW + 1) * ROLLING_TOKEN_WINDOW_S;
+
+    for (size_t i = 0; i < TOKEN_REPLAY_SLOTS; i++) {
+        const Seen& entry = seen[i];
+        if (entry.used && seconds - entry.at < remember && entry.token == token
+            && entry.event == event && entry.value == value) {
+            return false;
+        }
+    }
+
+    // Slots are taken in turn, the next one holds the oldest command
+    Seen& entry = seen[next];
+    entry.token = token;
+    entry.event = event;
+    entry.value = value;
+    entry.at = seconds;
+    entry.used = true;
+    next = (next + 1) % TOKEN_REPLAY_SLOTS;
+    return true;
+}
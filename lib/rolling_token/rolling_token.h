@@ -0,0 +1,102 @@
+/**
+ * Author: Malav Patel
+ * Description: Purpose of this file is to define the token the client
+ * Application puts in front of its commands. Both sides derive it from a
+ * shared secret and the current time window, so it never has to be sent.
+ */
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Seconds one token is valid for
+#define ROLLING_TOKEN_WINDOW_S 30
+// Windows before and after the current one whose token is still accepted,
+// covering clocks that disagree and commands read late
+#define ROLLING_TOKEN_SKEW 1
+// Bytes of the shared secret
+#define ROLLING_TOKEN_KEY_SIZE 16
+// Commands TokenReplayGuard remembers while their token is still accepted
+#define TOKEN_REPLAY_SLOTS 8
+
+/**
+ * The token of a window is the keyed SipHash-2-4 of the window index,
+ * truncated to 31 bits so it is a positive number on both the device and the
+ * client Application. Without the secret the token of a window can not be
+ * told from the tokens of the windows before it.
+ */
+class RollingToken {
+public:
+    /**
+     * Description: Constructor for RollingToken
+     * Pre: key holds ROLLING_TOKEN_KEY_SIZE bytes.
+     * Post: The key is copied.
+     */
+    explicit RollingToken(const char* key);
+
+    /**
+     * Description: The window a time falls in.
+     * Pre: None
+     * Post: Returns the index of the window of seconds.
+     */
+    static uint32_t window(uint32_t seconds) { return seconds / ROLLING_TOKEN_WINDOW_S; }
+
+    /**
+     * Description: The token of a window.
+     * Pre: None
+     * Post: Returns the token, the same for the same key and window.
+     */
+    uint32_t at(uint32_t window) const;
+
+    /**
+     * Description: Checks a token against the windows around a time.
+     * Pre: seconds is the time the token was received at.
+     * Post: Returns true if token is the token of a window at most
+     * ROLLING_TOKEN_SKEW windows away from the window of seconds.
+     */
+    bool verify(uint32_t token, uint32_t seconds) const;
+
+private:
+    uint64_t k0;
+    uint64_t k1;
+};
+
+/**
+ * A token is accepted for 2 * ROLLING_TOKEN_SKEW + 1 windows, so a command
+ * read from the server can be written back and applied again until then.
+ * TokenReplayGuard remembers every command taken with its token for that long
+ * and refuses the same token and command a second time. A command that has
+ * to be repeated inside that time needs a token of another window, or a
+ * sequence number like the commands of an AppBatch.
+ *
+ * Once more than TOKEN_REPLAY_SLOTS commands were taken within that time the
+ * oldest is forgotten first.
+ */
+class TokenReplayGuard {
+    struct Seen {
+        uint32_t token;
+        int32_t event;
+        int32_t value;
+        uint32_t at;
+        bool used;
+    };
+
+    Seen seen[TOKEN_REPLAY_SLOTS];
+    size_t next;
+
+public:
+    /**
+     * Description: Constructor for TokenReplayGuard
+     * Pre: None
+     * Post: No command is remembered.
+     */
+    TokenReplayGuard();
+
+    /**
+     * Description: Takes a command that came with a valid token.
+     * Pre: The token was verified at seconds, times do not go back.
+     * Post: Returns false if the same token and command were taken while the
+     * token could still be accepted, otherwise they are remembered and true
+     * is returned.
+     */
+    bool take(uint32_t token, int32_t event, int32_t value, uint32_t seconds);
+};
@@ -0,0 +1,207 @@
+/**
+ * Author: Malav Patel
+ * Description: Purpose of this file is to implement the
+ * TimerWheel Class defined in timer_wheel.h
+ */
+#include "timer_wheel.h"
+
+#include <climits>
+
+static_assert((TIMER_WHEEL_SLOTS & (TIMER_WHEEL_SLOTS - 1)) == 0, "TIMER_WHEEL_SLOTS must be a power of two");
+static_assert(TIMER_WHEEL_TIMERS <= 127, "timers are linked with int8_t");
+
+TimerWheel::TimerWheel()
+    : tick(0)
+    , tick_time(0)
+{
+    for (int i = 0; i < TIMER_WHEEL_SLOTS; i++) {
+        heads[i] = -1;
+    }
+    for (int i = 0; i < TIMER_WHEEL_TIMERS; i++) {
+        Timer& timer = timers[i];
+        timer.deadline = 0;
+        timer.period = 0;
+        timer.rounds = 0;
+        timer.due_at = 0;
+        timer.next = -1;
+        timer.prev = -1;
+        timer.slot = -1;
+        timer.pending = false;
+        timer.fired = 0;
+        timer.overruns = 0;
+        timer.missed = 0;
+    }
+}
+
+void TimerWheel::start(unsigned long now)
+{
+    tick = 0;
+    tick_time = (uint32_t)now;
+}
+
+void TimerWheel::link(int id)
+{
+    Timer& timer = timers[id];
+
+    // Ticks from the current one to the first tick at or after the deadline
+    int32_t ahead_ms = (int32_t)(timer.deadline - tick_time);
+    uint32_t ticks = ahead_ms <= 0 ? 1 : ((uint32_t)ahead_ms + TIMER_WHEEL_TICK_MS - 1) / TIMER_WHEEL_TICK_MS;
+
+    timer.rounds = (ticks - 1) / TIMER_WHEEL_SLOTS;
+    timer.slot = (int16_t)((tick + ticks) & (TIMER_WHEEL_SLOTS - 1));
+    timer.prev = -1;
+    timer.next = heads[timer.slot];
+    if (timer.next >= 0) {
+        timers[timer.next].prev = (int8_t)id;
+    }
+    heads[timer.slot] = (int8_t)id;
+}
+
+void TimerWheel::unlink(int id)
+{
+    Timer& timer = timers[id];
+    if (timer.slot < 0) {
+        return;
+    }
+    if (timer.prev >= 0) {
+        timers[timer.prev].next = timer.next;
+    } else {
+        heads[timer.slot] = timer.next;
+    }
+    if (timer.next >= 0) {
+        timers[timer.next].prev = timer.prev;
+    }
+    timer.slot = -1;
+    timer.next = -1;
+    timer.prev = -1;
+}
+
+void TimerWheel::schedule(int id, unsigned long delay_ms, unsigned long period_ms, unsigned long now)
+{
+    if (id < 0 || id >= TIMER_WHEEL_TIMERS) {
+        return;
+    }
+    unlink(id);
+    timers[id].deadline = (uint32_t)now + (uint32_t)delay_ms;
+    timers[id].period = (uint32_t)period_ms;
+    link(id);
+}
+
+void TimerWheel::cancel(int id)
+{
+    if (id >= 0 && id < TIMER_WHEEL_TIMERS) {
+        unlink(id);
+        timers[id].pending = false;
+    }
+}
+
+size_t TimerWheel::advance(unsigned long now, void (*fire)(int id, bool overrun))
+{
+    size_t count = 0;
+
+    while ((uint32_t)((uint32_t)now - tick_time) >= TIMER_WHEEL_TICK_MS) {
+        tick++;
+        tick_time += TIMER_WHEEL_TICK_MS;
+
+        // Take the due timers off the slot first, fire may schedule others
+        int due[TIMER_WHEEL_TIMERS];
+        int due_count = 0;
+        for (int id = heads[tick & (TIMER_WHEEL_SLOTS - 1)]; id >= 0; id = timers[id].next) {
+            if (timers[id].rounds > 0) {
+                timers[id].rounds--;
+            } else {
+                due[due_count++] = id;
+            }
+        }
+
+        for (int i = 0; i < due_count; i++) {
+            int id = due[i];
+            Timer& timer = timers[id];
+            // Cancelled or scheduled again by the fire of a timer before it
+            if (timer.slot != (int16_t)(tick & (TIMER_WHEEL_SLOTS - 1)) || timer.rounds > 0) {
+                continue;
+            }
+            unlink(id);
+            timer.fired++;
+
+            bool overrun = timer.pending;
+            if (overrun) {
+                timer.overruns++;
+            } else {
+                timer.pending = true;
+                timer.due_at = timer.deadline;
+            }
+
+            if (timer.period > 0) {
+                // From the deadline so it does not drift, skipping the
+                // periods that are already over after a long stall
+                timer.deadline += timer.period;
+                while ((int32_t)(timer.deadline - tick_time) <= 0) {
+                    timer.deadline += timer.period;
+                    timer.missed++;
+                }
+                link(id);
+            }
+
+            fire(id, overrun);
+            count++;
+        }
+    }
+    return count;
+}
+
+unsigned long TimerWheel::next_due_in(unsigned long now) const
+{
+    unsigned long next = ULONG_MAX;
+
+    for (int id = 0; id < TIMER_WHEEL_TIMERS; id++) {
+        const Timer& timer = timers[id];
+        if (timer.slot < 0) {
+            continue;
+        }
+        // The timer fires on the tick its slot comes round after its rounds
+        uint32_t ticks = (uint32_t)((timer.slot - tick) & (TIMER_WHEEL_SLOTS - 1));
+        if (ticks == 0) {
+            ticks = TIMER_WHEEL_SLOTS;
+        }
+        ticks += timer.rounds * TIMER_WHEEL_SLOTS;
+
+        int32_t due_in = (int32_t)(tick_time + ticks * TIMER_WHEEL_TICK_MS - (uint32_t)now);
+        unsigned long ms = due_in > 0 ? (unsigned long)due_in : 0;
+        if (ms < next) {
+            next = ms;
+        }
+    }
+    return next;
+}
+
+bool TimerWheel::ran(int id, unsigned long now)
+{
+    if (id < 0 || id >= TIMER_WHEEL_TIMERS || !timers[id].pending) {
+        return false;
+    }
+    Timer& timer = timers[id];
+    timer.pending = false;
+    timer.jitter.record(((uint32_t)now - timer.due_at) * 1000);
+    return true;
+}
+
+uint32_t TimerWheel::fired_count(int id) const
+{
+    return timers[id].fired;
+}
+
+uint32_t TimerWheel::overrun_count(int id) const
+{
+    return timers[id].overruns;
+}
+
+uint32_t TimerWheel::missed_count(int id) const
+{
+    return timers[id].missed;
+}
+
+const LatencyHistogram& TimerWheel::jitter(int id) const
+{
+    return timers[id].jitter;
+}
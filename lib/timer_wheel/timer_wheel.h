@@ -0,0 +1,124 @@
+/**
+ * Author: Malav Patel
+ * Description: Purpose of this file is to define a helper class
+ * TimerWheel that keeps the deadlines of the periodic and deferred work of
+ * the main loop.
+ */
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+#include "latency_stats.h"
+
+// Slots of the wheel, a power of two
+#define TIMER_WHEEL_SLOTS 64
+// Milliseconds one slot stands for, a timer is never early and at most this late
+#define TIMER_WHEEL_TICK_MS 10
+// Number of timers, a timer is named by its index
+#define TIMER_WHEEL_TIMERS 8
+
+/**
+ * A helper class TimerWheel is a hashed timer wheel: a timer is kept in the
+ * slot its deadline falls in, with the number of turns of the wheel left
+ * before it is due, so scheduling and cancelling only link or unlink it and
+ * advancing only looks at the slots of the ticks that passed.
+ *
+ * A periodic timer is scheduled again from its deadline, not from the time it
+ * fired, so it does not drift. When a timer fires it is pending until ran()
+ * is called for it; the time from the deadline to ran() is its jitter. A
+ * timer that fires again while still pending is counted as an overrun, which
+ * fire is told about so the work can be run right away instead of waiting
+ * any longer.
+ */
+class TimerWheel {
+    struct Timer {
+        uint32_t deadline;
+        uint32_t period;
+        uint32_t rounds;
+        uint32_t due_at;
+        int8_t next;
+        int8_t prev;
+        int16_t slot;
+        bool pending;
+
+        uint32_t fired;
+        uint32_t overruns;
+        uint32_t missed;
+        LatencyHistogram jitter;
+    };
+
+    Timer timers[TIMER_WHEEL_TIMERS];
+    int8_t heads[TIMER_WHEEL_SLOTS];
+
+    uint32_t tick;
+    uint32_t tick_time;
+
+    void link(int id);
+    void unlink(int id);
+
+public:
+    TimerWheel();
+
+    /**
+     * Description: Start the wheel at a time.
+     * Pre: Called once before the first timer is scheduled.
+     * Post: Ticks are counted from now.
+     */
+    void start(unsigned long now);
+
+    /**
+     * Description: Schedule a timer, replacing its previous schedule.
+     * Pre: id < TIMER_WHEEL_TIMERS
+     * Post: The timer fires delay_ms after now, and every period_ms after
+     * that unless period_ms is 0.
+     */
+    void schedule(int id, unsigned long delay_ms, unsigned long period_ms, unsigned long now);
+
+    /**
+     * Description: Stop a timer.
+     * Pre: None
+     * Post: The timer does not fire until it is scheduled again.
+     */
+    void cancel(int id);
+
+    /**
+     * Description: Fire every timer whose deadline has passed.
+     * Pre: Called on every iteration of the main loop with millis().
+     * Post: fire(id, overrun) was called for every timer that became due, in
+     * the order of the ticks they fell in. Returns the number fired.
+     */
+    size_t advance(unsigned long now, void (*fire)(int id, bool overrun));
+
+    /**
+     * Description: Milliseconds until advance() fires the next timer.
+     * Pre: None
+     * Post: Returns 0 if a timer is due already, ULONG_MAX if no timer
+     * is scheduled.
+     */
+    unsigned long next_due_in(unsigned long now) const;
+
+    /**
+     * Description: Record that the work of a timer ran.
+     * Pre: None
+     * Post: Returns false if the timer was not pending, otherwise its jitter
+     * is recorded and it is no longer pending.
+     */
+    bool ran(int id, unsigned long now);
+
+    /**
+     * Description: Counters of a timer: times it fired, times it fired while
+     * still pending, and periods that passed without it firing.
+     * Pre: id < TIMER_WHEEL_TIMERS
+     * Post: Returns the count since boot.
+     */
+    uint32_t fired_count(int id) const;
+    uint32_t overrun_count(int id) const;
+    uint32_t missed_count(int id) const;
+
+    /**
+     * Description: Microseconds from the deadlines of a timer until its work ran.
+     * Pre: id < TIMER_WHEEL_TIMERS
+     * Post: Returns the histogram.
+     */
+    const LatencyHistogram& jitter(int id) const;
+};
@@ -0,0 +1,21 @@
+#!/bin/sh
+# Author: Malav Patel
+# Runs every script in this directory through the simulator and fails if
+# any run ends with a violation.
+#
+# Usage: sim/run.sh [program], the default is the program of the sim environment
+program=${1:-.pio/build/sim/program}
+dir=$(dirname "$0")
+failed=0
+
+for script in "$dir"/*.txt; do
+    if report=$("$program" --script "$script" 2>&1 >/dev/null); then
+        echo "ok      $script"
+    else
+        echo "FAILED  $script"
+        echo "$report" | grep -v '^[a-z ()/]*: ' | sed 's/^/        /'
+        failed=1
+    fi
+done
+
+exit $failed
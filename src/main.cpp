@@ -10,30 +10,44 @@
  *
  */
 
-#include <Arduino.h>
-#include <LiquidCrystal.h>
-#include <SPIFFS.h>
-#include <Servo.h>
-#include <WiFiClientSecure.h>
+#include <algorithm>
+#include <array>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
-#include <map>
+#include <new>
 #include <queue>
 #include <string>
 #include <thread>
+#include <utility>
 
-#include "at_client.h"
+// This import includes the Arduino core, the peripheral libraries and the
+// at_client library on ESP32, or in-memory fakes of them on the native build.
+#include "hal.h"
 
 // This import includes the Macros definations that maps the pins
 // to the a number indicated by the Pin Manual of ESP32.
 // It also includes the Wifi details
 #include "constants.h"
 
+#include "app_command.h"
+#include "at_cache.h"
+#include "at_monitor.h"
+#include "cycle_log.h"
+#include "device_state.h"
+#include "door_motion.h"
 #include "event_bus.h"
-
-using std::deque;
-using std::string;
-using std::to_string;
+#include "event_dispatch.h"
+#include "idle_stats.h"
+#include "key_store.h"
+#include "latency_stats.h"
+#include "lcd_frame.h"
+#include "log_ring.h"
+#include "net_worker.h"
+#include "quadrature.h"
+#include "rolling_token.h"
+#include "timer_wheel.h"
 
 //-------------- GLOBAL VARIABLES ------------------------------------------//
 
@@ -43,7 +57,7 @@ using std::to_string;
  * reading the at_sign secondary server.
  */
 /// Event is documented
-enum Event {
+enum Event : uint8_t {
     // Sync the status of Door with at_sign secondary server
     SYNC_DOOR,
     // Sync the RE_VALUE with at_sign secondary server
@@ -74,10 +88,207 @@ enum Event {
     RE_INC,
     // Occurs when Rotary Encoder Module is moved in negative side.
     RE_DEC,
+    // Occurs when a door movement started by the Rotary Encoder has finished
+    DOOR_MOVED,
+    // Occurs when the network task has finished a request to the at_sign secondary server
+    NET_COMPLETED,
+    // Occurs when the at_sign secondary server notifies that app_events_key was updated
+    APP_E_NOTIFIED,
+    // Print the latency statistics on the serial console
+    STATS_DUMP,
+    // Move the door to the percentage open in the payload, 0 to 100
+    DOOR_MOVE_TO,
+    // A timer of timer_wheel is due, the payload is its TimerId
+    TIMER_DUE,
+    // The number of events, must stay last
+    EVENT_COUNT
+};
+
+/**
+ * An Enum naming what caused an event to be added.
+ */
+enum EventSource : uint8_t {
+    // Added by the firmware itself, for example by another handler
+    device = 0,
+    // The Capacitive Touch Sensor Module
+    touch = 1,
+    // The Rotary Encoder Module
+    encoder = 2,
+    // The client Application through the at_sign secondary server
+    app = 3
+};
+
+static_assert(IDLE_SOURCES > EventSource::app, "idle_stats has too few sources");
+
+/**
+ * The names of the sources in the statistics.
+ */
+static const char* const EVENT_SOURCE_NAMES[] = { "device", "touch", "encoder", "app" };
+
+/**
+ * The entry that is put on the EventBus: the Event that occured, the door it
+ * is about and a small payload for the handler. A Message is 6 bytes and
+ * copied by value, nothing is allocated. An Event converts to a Message
+ * without a payload for door 0.
+ */
+struct Message {
+    Event type;
+    // What caused the event
+    EventSource source;
+    // The index in doors of the door the event is about
+    uint8_t door;
+    // The motion of the door the event belongs to, 0 for none, so the
+    // events of a motion can be cancelled together
+    uint8_t correlation;
+    // Event specific value, for example the number of 20% steps to move
+    // or the percentage to move the door to
+    int16_t value;
+
+    Message(Event type = Event::SYNC_DOOR, int16_t value = 0, EventSource source = EventSource::device, uint8_t door = 0, uint8_t correlation = 0)
+        : type(type)
+        , source(source)
+        , door(door)
+        , correlation(correlation)
+        , value(value)
+    {
+    }
+};
+
+/**
+ * Used by EventBus to keep its per kind bookkeeping for each Event.
+ */
+inline size_t event_kind(const Message& message)
+{
+    return message.type;
+}
+
+/**
+ * Used by EventBus to cancel the events of one motion together.
+ */
+inline size_t event_correlation(const Message& message)
+{
+    return message.correlation;
+}
+
+/**
+ * Used by EventBus to cancel the motion of one door without touching the
+ * others.
+ */
+inline size_t event_partition(const Message& message)
+{
+    return message.door;
+}
+
+/**
+ * An Enum of the levels of the EventBus, the events of a more urgent level
+ * are always handled first.
+ */
+enum Priority {
+    // Halting the door
+    safety = 0,
+    // Everything that starts, moves or settles the door, and the commands
+    // received from the client Application
+    motion = 1,
+    // The LCD and the Rotary Encoder mode
+    ui = 2,
+    // Writing the state to the AtSign secondary server and taking what the
+    // network task and the monitor received from it
+    sync = 3,
+    PRIORITY_COUNT
+};
+
+/**
+ * An Enum of the timers of timer_wheel, the periodic work of the main loop.
+ */
+enum TimerId {
+    // Read app_events_key while the monitor is not connected
+    app_e_poll = 0,
+    // Publish telemetry_key
+    telemetry = 1,
+    TIMER_COUNT
+};
+
+static_assert(TIMER_COUNT <= TIMER_WHEEL_TIMERS, "timer_wheel has too few timers");
+
+/**
+ * The names of the timers in the statistics.
+ */
+static const char* const TIMER_NAMES[TIMER_COUNT] = { "app_e poll", "telemetry" };
+
+/**
+ * An Enum of what a record of log_ring says, the text of each is in LOG_FORMATS.
+ */
+enum LogId : uint16_t {
+    log_door_opening = 0,
+    log_door_opened = 1,
+    log_door_closing = 2,
+    log_door_closed = 3,
+    log_door_halted = 4,
+    log_door_moving_to = 5,
+    log_re_value = 6,
+    log_app_data = 7,
+    log_app_batch_rejected = 8,
+    log_app_token_rejected = 9,
+    log_app_command = 10,
+    log_app_token_replayed = 11,
+    LOG_COUNT
+};
+
+/**
+ * The text of the records, printf formats taking the two fields of a record
+ * as long. Doors are numbered from 1 like on the LCD.
+ */
+static const char* const LOG_FORMATS[LOG_COUNT] = {
+    "DOOR %ld IS OPENING (source %ld)",
+    "DOOR %ld IS OPENED",
+    "DOOR %ld IS CLOSING (source %ld)",
+    "DOOR %ld IS CLOSED",
+    "DOOR %ld HALTED in %ld ms",
+    "DOOR %ld IS MOVING TO %ld%%",
+    "DOOR %ld RE_VALUE: %ld",
+    "app_e value of %ld bytes, marker %ld",
+    "app_e batch of %ld bytes rejected",
+    "app_e token %ld rejected at %ld",
+    "app_e command %ld, value %ld",
+    "app_e token %ld replayed, command %ld",
 };
 
+// The longest line a record is printed as, it is only printed once the
+// serial port can take a line this long without blocking
+#define LOG_LINE_MAX 64
+// The main loop comes back at least this often while records are waiting
+#define LOG_DRAIN_MS 10
+
+#define LOG_WARN(id, a, b) LOG_RECORD(log_ring, LOG_LEVEL_WARN, id, a, b)
+#define LOG_INFO(id, a, b) LOG_RECORD(log_ring, LOG_LEVEL_INFO, id, a, b)
+#define LOG_DEBUG(id, a, b) LOG_RECORD(log_ring, LOG_LEVEL_DEBUG, id, a, b)
+
+// Motions of a door that can be told apart, correlation IDs 1 to
+// MOTION_IDS - 1 are given out in turn, door d uses them plus d * MOTION_IDS
+#define MOTION_IDS 16
+
 // A static GLOBAL variable of an helper class EventBus
-static EventBus<Event> events;
+static EventBus<Message, 64, 8, 32, PRIORITY_COUNT, MOTION_IDS * DOOR_COUNT, DOOR_COUNT> events;
+
+/**
+ * An static GLOBAL wheel of the deadlines of the periodic work. Timers fire
+ * on every iteration of the main loop whatever is waiting on the EventBus,
+ * and add TIMER_DUE so their work is done between the other events.
+ */
+static TimerWheel timer_wheel;
+
+/**
+ * An static GLOBAL account of the time the main loop waited for work against
+ * the time it worked, and of how long the inputs that woke it waited.
+ */
+static IdleStats idle_stats;
+
+/**
+ * An static GLOBAL ring of the log records. Handlers add a record in a few
+ * hundred nanoseconds, the main loop prints them while it has nothing else to
+ * do, as much as the serial port takes without blocking.
+ */
+static LogRing log_ring;
 
 /**
  * An Enum tracking the state of an door to an int.
@@ -91,13 +302,6 @@ enum DoorStatus {
     closing = 3
 };
 
-/**
- * An static GLOBAL variable tracking the state of the door.
- * Will be used by the various event handlers.
- */
-static DoorStatus DOOR_STATUS
-    = DoorStatus::closed;
-
 /**
  * An Enum tracking the state of a Rotary Encoder to check if
  * it signals are ment to be read or its in a passive state
@@ -115,59 +319,286 @@ enum REStatus {
 static REStatus RE_STATUS = REStatus::set;
 
 /**
- * An static GLOBAL variable tracking the amount of rotated on the Rotart Encoder.
- * Will be used by various event handlers.
+ * An static GLOBAL decoder fed by the interrupts of both Rotary Encoder signals.
+ * The main loop takes the net detents from it in one go.
  */
-static int RE_VALUE = RE_VALUE_MAX;
+static QuadratureDecoder re_decoder(RE_STEPS_PER_DETENT);
 
 /**
- * An static GLOBAL variable tracking the angle of the Servo Motor.
- * Will be used by various event handlers.
+ * Net detents taken from re_decoder since boot, positive when turned forward.
+ */
+static int32_t RE_DETENTS = 0;
+
+/**
+ * An static GLOBAL variable tracking the door the touch sensor, the Rotary
+ * Encoder and the LCD act on. With more than one door, turning the Rotary
+ * Encoder while it is in REStatus::set selects the next one.
+ */
+static volatile uint8_t SELECTED_DOOR = 0;
+
+/**
+ * The AtSign of the device and of the client Application.
  */
-static int SERVO_ANGLE = 0;
+static const char CHIP_ATSIGN[] = "@moralbearbanana";
+static const AtSign chip_atsign(CHIP_ATSIGN);
+static const AtSign java_atsign("@batmanariesbanh");
+
+/**
+ * The WiFi network the device joins, again whenever the link is lost.
+ */
+static const char WIFI_SSID[] = "hotspot";
+static const char WIFI_PASSWORD[] = "12345678";
 
 /**
  * The AtSign library client responsible for reading data and storing
  * data on the AtSign secondary server so that Client Application has
- * access to it.
+ * access to it. It can only be constructed in setup() once the keys are
+ * read, so it is placed in static storage instead of on the heap.
  */
+alignas(AtClient) static uint8_t at_client_storage[sizeof(AtClient)];
 static AtClient* at_client;
 
+/**
+ * The network task that owns at_client once setup is done. Every request to
+ * the AtSign secondary server is posted to it so the main loop never waits
+ * on the network.
+ */
+static NetWorker net_worker;
+
+/**
+ * Keeps a monitor connection open for app_events_key so that events from the
+ * client Application are pushed to the device. While it is not connected the
+ * main loop falls back to polling app_events_key every 15 seconds.
+ */
+static AtMonitor app_monitor;
+
+/**
+ * The local copy of every value the device publishes. Handlers set values
+ * here and only the ones that changed are written to the secondary server,
+ * together, on a state transition or every AT_CACHE_FLUSH_MS.
+ */
+static AtKeyCache at_cache;
+
 /**
  *  Responsibe for reading events that has occured from the
  * client Application.
  */
-static AtKey* app_events_key;
+static AtKey app_events_key("app_e", &java_atsign, &chip_atsign);
+/**
+ * Used to publish a compact summary of the latency statistics when
+ * TELEMETRY_PUBLISH_MS is set.
+ */
+static AtKey telemetry_key("telemetry", &chip_atsign, &java_atsign);
+/**
+ * Used to tell the client Application the sequence number of the last
+ * command of a batch that was applied, so it can leave it out of the next one.
+ */
+static AtKey app_ack_key("app_ack", &chip_atsign, &java_atsign);
+/**
+ * Used to upload the records of cycle_log, a few at a time.
+ */
+static AtKey door_cycles_key("door_cycles", &chip_atsign, &java_atsign);
+
+/**
+ * Description: This function names the AtKey of a door. Door 0 keeps the
+ * names the client Application has always read, the others add the number
+ * of the door, for example door_status_2.
+ * Pre: None
+ * Post: Returns the name.
+ */
+static std::string door_key_name(const char* name, size_t door)
+{
+    return door == 0 ? std::string(name) : std::string(name) + "_" + std::to_string(door + 1);
+}
+
+/**
+ * The servo pin of every door, indexed like doors.
+ */
+static const uint8_t DOOR_SERVOS[] = DOOR_SERVO_PINS;
+
+/**
+ * Everything that belongs to one door: its status, its servo and the
+ * DoorMotion moving it, the values published for it and their AtKeys. The
+ * main loop advances the motion of every door, so they move at the same time.
+ */
+struct Door {
+    // What the door is doing, read by the touch interrupt handler
+    DoorStatus status;
+    // How far the Rotary Encoder would be turned for the door, RE_VALUE_MIN
+    // is open and RE_VALUE_MAX closed
+    int re_value;
+    // How far the door is open, 0 to 100 percent. Unlike re_value it is not
+    // limited to steps of RE_STEP_SIZE.
+    int position;
+    // The angle of the servo
+    int servo_angle;
+    // Moves servo_angle towards a target angle a degree at a time from the
+    // main loop, without blocking it
+    DoorMotion motion;
+    // The event that is added to the EventBus once motion reaches its
+    // target, and the correlation ID of the motion it is added with
+    Event motion_done;
+    uint8_t motion_id;
+    // The millis() at which the last DOOR_HALT was requested, used to
+    // measure the time it took for the door to stop
+    volatile unsigned long halt_requested_at;
+    Servo servo;
+    uint8_t servo_pin;
+    // Used to update the secondary server with the status of the door, the
+    // value of the Rotary Encoder and the percentage the door is open
+    AtKey status_key;
+    AtKey re_value_key;
+    AtKey position_key;
+    // The cycle the door is in, recorded in cycle_log once it ends, and the
+    // millis() it started at
+    DoorCycle cycle;
+    unsigned long cycle_started_at;
+    bool cycling;
+
+    Door(size_t index)
+        : status(DoorStatus::closed)
+        , re_value(RE_VALUE_MAX)
+        , position(0)
+        , servo_angle(0)
+        , motion(0, SERVO_ANGLE_MIN, SERVO_ANGLE_MAX, SERVO_MS_PER_DEGREE)
+        , motion_done(Event::DOOR_MOVED)
+        , motion_id(0)
+        , halt_requested_at(0)
+        , servo_pin(DOOR_SERVOS[index])
+        , status_key(door_key_name("door_status", index), &chip_atsign, &java_atsign)
+        , re_value_key(door_key_name("re_value", index), &chip_atsign, &java_atsign)
+        , position_key(door_key_name("door_position", index), &chip_atsign, &java_atsign)
+        , cycle()
+        , cycle_started_at(0)
+        , cycling(false)
+    {
+    }
+};
+
+static_assert(DOOR_COUNT >= 1 && DOOR_COUNT <= sizeof(DOOR_SERVOS), "DOOR_SERVO_PINS has too few pins");
+static_assert(DOOR_COUNT <= DEVICE_STATE_DOORS, "the snapshot has too few doors");
+static_assert(DOOR_COUNT <= APP_BATCH_DOORS, "an AppBatch can not address every door");
+static_assert(DOOR_COUNT <= 4, "a DoorCycle record has room for four doors");
+static_assert(3 * DOOR_COUNT + 3 <= AT_CACHE_KEYS, "at_cache has too few keys");
+
+template <size_t... I>
+static std::array<Door, sizeof...(I)> make_doors(std::index_sequence<I...>)
+{
+    return { { Door(I)... } };
+}
+
+/**
+ * An static GLOBAL array of the doors, the door of an event is
+ * doors[message.door].
+ */
+static std::array<Door, DOOR_COUNT> doors = make_doors(std::make_index_sequence<DOOR_COUNT>());
+
+/**
+ * The sequence number of the last command from the client Application that
+ * was applied, unknown until the first batch after boot is received.
+ */
+static uint16_t APP_SEQUENCE = 0;
+static bool APP_SEQUENCE_KNOWN = false;
+
+/**
+ * Commands from the client Application that were applied, that were skipped
+ * because they had been applied already, batches that could not be decoded,
+ * values that did not carry the token of the current time window and values
+ * of the legacy form whose token and command were taken before.
+ */
+static uint32_t APP_COMMANDS_APPLIED = 0;
+static uint32_t APP_COMMANDS_REPEATED = 0;
+static uint32_t APP_BATCHES_REJECTED = 0;
+static uint32_t APP_TOKENS_REJECTED = 0;
+static uint32_t APP_TOKENS_REPLAYED = 0;
+
+/**
+ * The version app_events_key had when a poll last read it and a hash of the
+ * last value handled, by a poll or the monitor, both 0 before the first. A
+ * poll that finds the same version does not read the value again, a value
+ * with the hash of the last one is not handled again.
+ */
+static uint32_t APP_E_VERSION = 0;
+static uint32_t APP_E_HASH = 0;
+
+/**
+ * Polls of app_events_key, those that were not read because its version had
+ * not moved, which the ESP32 build can not tell so it reads every time, and
+ * those that read the value the last one had read.
+ */
+static uint32_t APP_E_POLLS = 0;
+static uint32_t APP_E_POLLS_NOT_READ = 0;
+static uint32_t APP_E_POLLS_SAME = 0;
+
+/**
+ * Values of app_events_key the monitor delivered and those that had the hash
+ * of the last value handled, most often one a poll had read already.
+ */
+static uint32_t APP_E_MONITORED = 0;
+static uint32_t APP_E_MONITORED_SAME = 0;
+
+/**
+ * The token the client Application puts in front of its commands, derived
+ * on both sides from APP_TOKEN_SECRET and the time of day.
+ */
+static const RollingToken app_token(APP_TOKEN_SECRET);
+static_assert(sizeof(APP_TOKEN_SECRET) - 1 == ROLLING_TOKEN_KEY_SIZE, "APP_TOKEN_SECRET has the wrong length");
+
+/**
+ * The commands of the legacy form taken with their token. Unlike a batch
+ * they carry no sequence number, without it a value written back to
+ * app_events_key would be applied again while its token is accepted.
+ */
+static TokenReplayGuard app_replay_guard;
+
 /**
- * Used to update the secondary server with random token that the
- * client Application has to read before an event is put in app_events_key.
+ * Keeps the snapshot of the door, the Rotary Encoder and the published values
+ * in flash, so a reboot carries on from it.
  */
-static AtKey* event_bus_key;
+static DeviceStateStore device_state;
+
 /**
- * Used to update the secondary server with the current status of the door.
+ * The history of the cycles of the doors, checkpointed to flash and uploaded
+ * to door_cycles_key while the main loop is idle.
  */
-static AtKey* door_status_key;
+static CycleLog cycle_log;
+
 /**
- * Used to update the secondary server with the current value of the Rotary Encoder.
+ * The micros() at which the event that is being handled was added to the
+ * EventBus, so a handler can tell how long its command waited.
  */
-static AtKey* re_value_key;
+static uint32_t HANDLED_ADDED_AT = 0;
 
-Servo servo;
+/**
+ * How long setup() took until the device was ready, how much of it went to
+ * the keys, whether they came from the copy in flash and whether the state
+ * was restored from a snapshot.
+ */
+static unsigned long BOOT_MICROS = 0;
+static unsigned long BOOT_KEYS_MICROS = 0;
+static bool BOOT_KEYS_CACHED = false;
+static bool BOOT_WARM = false;
 
 /**
  * Initialise the LCD with the pin in a 4-bit mode.
  */
 LiquidCrystal lcd(RS, RW, ENABLE, D4, D5, D6, D7);
 
+/**
+ * What the LCD should show. The LCD handlers draw here and the main loop
+ * sends only the cells that changed, at most every LCD_REFRESH_MS.
+ */
+static LcdFrame lcd_frame;
+
 //-------------- Arduino Interrput Handlers ------------------------------------------//
 
 /**
  * Description: TouchInterruptHandler() will be used as callback for
  * arduino attachInterruptHandler method, with RISING mode to handle
  * the touch event from Capacitve Touch Sensor Module more efficeintly.
- * The function will be adding the events to event bus based on the state
- * of constant DOOR_STATUS.
- * Pre: A static EventBus events and DoorStatus DOOR_STATUS should have been
+ * The function will be adding the events to event bus based on the status
+ * of the door SELECTED_DOOR.
+ * Pre: A static EventBus events and the doors should have been
  * declared and present in GLOBAL.
  * Post:
  * If door is open then event to close the door will be added.
@@ -194,19 +625,35 @@ void REButtonHandler();
 
 /**
  * Description: RERotateHandler() will be used as callback for
- * arduino attachInterruptHandler method, with Falling mode to handle
- * the Output from CLK Pin of Rotary Encoder Module more efficeintly.
- * The function will add events to event bus if the Rotary Encoder dial
- * was moved in positive side or negative side.
- * Pre: A static EventBus events, RE_VALUE and RE_STATUS should have been
- * declared and present in GLOBAL.
- * Post:
- * If the Dial on Rotary Encoder was rotated in positive side
- * then RE_INC event will be added in EventBus else RE_DEC event will be
- * added on the event bus.
+ * arduino attachInterruptHandler method, with Change mode on both the
+ * CLK and DAT Pin of Rotary Encoder Module. The function feeds the level
+ * of both signals to re_decoder, which counts the steps the dial turned.
+ * Pre: A static QuadratureDecoder re_decoder should have been declared and
+ * present in GLOBAL.
+ * Post: The steps of re_decoder are updated, no event is added.
  */
 void RERotateHandler();
 
+/**
+ * Description: This function is called first by the interrupt handlers of
+ * the inputs. It wakes the main loop if it is waiting and tells idle_stats
+ * which input woke it.
+ * Pre: pin was passed to idle_wake_on() in setup().
+ * Post: idle_wait() returns.
+ */
+void idle_input(EventSource source, uint8_t pin);
+
+/**
+ * Description: This function is called on every iteration of the main loop and
+ * takes the detents the Rotary Encoder turned since the last call. In
+ * REStatus::change they are added as a single RE_INC or RE_DEC carrying the
+ * number of detents for SELECTED_DOOR. Otherwise they select another door if
+ * there is more than one, or are dropped.
+ * Pre: None
+ * Post: At most one event is added to EventBus
+ */
+void re_rotation_drain();
+
 //-------------- Event Handlers ------------------------------------------//
 
 /**
@@ -215,82 +662,354 @@ void RERotateHandler();
  * Pre: None
  * Post: Events are added to EventBus
  */
-void door_will_open();
+void door_will_open(const Message& message);
 /**
  * Description: This function will add all the event in the event bus
  * that will needs to be performed when door is opened and will update
- * the RE_VALUE to RE_MIN to indicate the door has been opened.
+ * the re_value of the door to RE_MIN to indicate the door has been opened.
  * Pre: None
  * Post: Events are added to EventBus
  */
-void door_has_opened();
+void door_has_opened(const Message& message);
 /**
  * Description: This function will add all the events in th event bus
  * that needs to be performed for the action of for door closing.
  * Pre: None
  * Post: Events are added to EventBus
  */
-void door_will_close();
+void door_will_close(const Message& message);
 /**
  * Description: This function will add all the events in the event bus
  * that will needs to be performed when door is closed and will update
- * the RE_VALUE to RE_MAX to indicate the door has been closed.
+ * the re_value of the door to RE_MAX to indicate the door has been closed.
  * Pre: None
  * Post: Events are added to EventBus
  */
-void door_has_closed();
+void door_has_closed(const Message& message);
+/**
+ * Description: This function will stop the door and cancel every event of
+ * Priority::motion for it waiting in the event bus i.e. DOOR_OPEN_BY_20,
+ * DOOR_CLOSE_BY_20 or the arrival of the halted motion, and will add all the
+ * event in th event bus that needs to be performed for the action of for door
+ * halting. The other doors keep moving.
+ * Pre: None
+ * Post: Events are added to and cancelled in EventBus
+ */
+void door_is_halted(const Message& message);
+
+/**
+ * Description: This function starts the record of a cycle of a door, when a
+ * command starts to open or close it. A cycle the door was still in ends as
+ * superseded.
+ * Pre: Called from the handler of the command.
+ * Post: The door is in a new cycle, its latency is the time the command
+ * waited on the EventBus.
+ */
+void door_cycle_begin(const Message& message, bool opening);
+/**
+ * Description: This function ends the cycle of a door and adds its record
+ * to cycle_log.
+ * Pre: None
+ * Post: The door is not in a cycle, nothing is recorded if it was not in one.
+ */
+void door_cycle_end(uint8_t door, DoorCycleEnd end);
 /**
- * Description: This function will remove all the events in event bus
- * that are responisble for the movement of door i.e. DOOR_OPEN_BY_20 and
- * DOOR_CLOSE_BY_20 and will add all the event in th event bus
- * that needs to be performed for the action of for door halting.
+ * Description: This function is called by the main loop when the EventBus is
+ * empty. Once the server has the last upload of cycle_log, and more records
+ * are due, it sets door_cycles_key to the next ones, which at_cache writes
+ * with its next flush. An upload that is never acknowledged is sent again by
+ * at_cache.expire() after AT_CACHE_IN_FLIGHT_MS, so the key always settles
+ * once the network works.
  * Pre: None
- * Post: Events are added and removed from EventBus
+ * Post: door_cycles_key is set or nothing is done.
  */
-void door_is_halted();
+void cycle_upload();
 
 /**
  * Description: This function is responisble for the calling the procedures
  * that will change the servo motor module's angle so the door is opened by 20%.
  * Pre:
- * Post: Servo angle is update to accommodate the door opening byy 20%
+ * Post: The target of the motion of the door is moved to open it by 20% more
+ * for each step in the payload, DOOR_MOVED is added once the door gets there.
  */
-void door_open_by_20();
+void door_open_by_20(const Message& message);
 /**
  * Description: This function is responisble for the calling the procedures
  * that will change the servo motor module's angle so the door is closed by 20%.
  * Pre: None
- * Post: Servo angle is update to accommodate the door closing by 20%
+ * Post: The target of the motion of the door is moved to close it by 20% more
+ * for each step in the payload, DOOR_MOVED is added once the door gets there.
+ */
+void door_close_by_20(const Message& message);
+/**
+ * Description: This function will add the events that show and sync the new
+ * re_value of the door once a movement to a position has finished, and sets
+ * the status of the door from where the servo stopped, whatever started it.
+ * Pre: None
+ * Post: Events are added to EventBus, SYNC_DOOR and LCD_SHOW_DOOR_STAT if
+ * the status changed.
+ */
+void door_has_moved(const Message& message);
+/**
+ * Description: This function is called on every iteration of the main loop and
+ * advances the motion of every door, writing the new angle to its servo and
+ * updating its re_value. A door that reaches its target adds its motion_done.
+ * Pre: None
+ * Post: The servo, servo_angle and re_value of every door reflect its position.
+ */
+void door_motion_tick();
+/**
+ * Description: Checks if any door is moving.
+ * Pre: None
+ * Post: Returns true if the motion of a door has not reached its target yet.
+ */
+bool doors_moving();
+/**
+ * Description: This function starts a new motion of a door to target_angle
+ * that adds done once it gets there. The previous motion of the door is
+ * replaced, an arrival of it that is still waiting on the EventBus is
+ * cancelled.
+ * Pre: door < DOOR_COUNT
+ * Post: The door is moving to the target, or done is added right away if
+ * the door is already there.
+ */
+void door_move(uint8_t door, int target_angle, Event done);
+/**
+ * Description: This function moves the door to the percentage open in the
+ * payload as a single motion. A move from the Rotary Encoder only scrubs the
+ * position, any other move updates the status like opening or closing does.
+ * Pre: None
+ * Post: The door is moving to the target, DOOR_OPENED, DOOR_CLOSED or
+ * DOOR_MOVED is added once the door gets there.
+ */
+void door_will_move_to(const Message& message);
+
+/**
+ * Description: This function prints the EventBus counters on the serial
+ * console: events dropped because the bus was full or cancelled, the network writes
+ * and LCD redraws saved by folding repeated events and the requests the
+ * network task performed or dropped, the monitor notifications received,
+ * the AtKey writes the cache avoided, the LCD cells the frame sent, the
+ * commands from the client Application, the door cycles recorded and
+ * uploaded, the boot time and snapshots, and the free, largest free block and
+ * least free heap.
+ * Pre: None
+ * Post: The counters are printed.
+ */
+void event_bus_report();
+
+/**
+ * Description: This function takes a snapshot of the state that has to
+ * outlive a reboot, with the values the server last acknowledged.
+ * Pre: None
+ * Post: Returns the snapshot, zeroed where nothing is known.
+ */
+DeviceState device_state_capture();
+/**
+ * Description: This function puts the doors and the last command of the
+ * client Application back to a snapshot, and tells the cache what the server
+ * had, so only what differs is written.
+ * Pre: The AtKeys are tracked by at_cache and the servos are attached.
+ * Post: The servo_angle, motion, servo, re_value, position and status of
+ * every door and APP_SEQUENCE are restored.
+ */
+void device_state_restore(const DeviceState& state);
+
+/**
+ * Description: This function is called by the main loop when the EventBus is
+ * empty. It waits until the next deadline of the door motions, the timers or
+ * a flush, at most IDLE_MAX_SLEEP_MS, so the ESP32 can sleep meanwhile. An
+ * input, a completed request or a notification ends the wait early.
+ * Pre: setup() has run.
+ * Post: The wait is accounted for in idle_stats.
+ */
+void idle_until_due();
+
+/**
+ * Description: This function is called by the main loop when the EventBus is
+ * empty and prints the oldest records of log_ring, as long as the serial port
+ * has room for a whole line.
+ * Pre: None
+ * Post: The records that were printed are removed from log_ring.
+ */
+void log_drain();
+
+/**
+ * Description: This function is called by the network task every time it
+ * finishes a request or connects again, and adds NET_COMPLETED to the
+ * EventBus, so the keys that waited for the link are flushed.
+ * Pre: None
+ * Post: Event is added to EventBus and the main loop is woken
+ */
+void net_worker_completed();
+/**
+ * Description: This function takes every completed request from the network
+ * task. Data read from app_events_key is checked against the token and turned
+ * into the door events the client Application asked for.
+ * Pre: None
+ * Post: Events are added to EventBus
+ */
+void net_request_completed();
+/**
+ * Description: This function takes the result of a poll of app_events_key.
+ * A value that was not read because the key was not updated is only counted,
+ * any other is handed to app_event_received().
+ * Pre: The poll completed.
+ * Post: APP_E_VERSION is updated, events are added to EventBus
+ */
+void app_event_polled(const NetCompletion& completion);
+/**
+ * Description: This function hashes a value of app_events_key (FNV-1a), so
+ * the device can tell it got the same value again without keeping it.
+ * Pre: None
+ * Post: Returns the hash, never 0.
+ */
+uint32_t app_value_hash(const char* data);
+/**
+ * Description: This function is called by the monitor task every time
+ * app_events_key is updated, and adds APP_E_NOTIFIED to the EventBus.
+ * Pre: None
+ * Post: Event is added to EventBus and the main loop is woken
+ */
+void app_monitor_notified();
+/**
+ * Description: This function takes every update of app_events_key the monitor
+ * has received and handles it as an Application event.
+ * Pre: None
+ * Post: Events are added to EventBus
+ */
+void app_event_notified();
+/**
+ * Description: This function checks the data of app_events_key, in the form
+ * "<event_id>z<token>", against the token and turns it into the door event
+ * the client Application asked for. DOOR_MOVE_TO carries the percentage the
+ * door should be open at as "<event_id>:<percent>z<token>". Parsed in place,
+ * data that is not in this form is ignored.
+ * Data starting with APP_BATCH_MARKER is an AppBatch, of which every command
+ * with a sequence number after the last applied one is applied in order, and
+ * app_ack_key is set to the last one.
+ * Both the monitor and the poll deliver values here, a value with the hash of
+ * the last one handled is ignored so no path applies a command twice.
+ * Pre: None
+ * Post: Returns false if the value was handled before, otherwise events are
+ * added to EventBus and APP_E_HASH is updated.
+ */
+bool app_event_received(const char* data);
+/**
+ * Description: This function applies one command from the client Application
+ * to a door. A halt is handled right away instead of going through the
+ * EventBus, so commands that follow it in the same batch are not cancelled
+ * with the motion it stops. Commands for a door the device does not drive are
+ * ignored.
+ * Pre: The token of the command was checked.
+ * Post: The door is halted or Events are added to EventBus
+ */
+void app_command_apply(int event_id, int value, uint8_t door);
+/**
+ * Description: This function checks the token of a value of app_events_key
+ * against the token of the current time window and the windows next to it.
+ * Pre: The time of day is known, otherwise every token is rejected.
+ * Post: Returns true if the token is valid, APP_TOKENS_REJECTED is
+ * incremented if it is not.
+ */
+bool app_token_valid(long token);
+
+/**
+ * Description: This function prints, for every kind of event that was handled,
+ * how long it waited on the EventBus and how long its handler ran, for every
+ * timer how late its work ran after its deadlines, followed by the EventBus
+ * counters.
+ * Pre: None
+ * Post: The statistics are printed on the serial console.
+ */
+void stats_dump();
+/**
+ * Description: This function sets telemetry_key to a compact summary of the
+ * statistics: EventBus high water mark and overflows, the kinds of event
+ * with the worst wait and the worst handler time, and the heap.
+ * Pre: None
+ * Post: The value is written with the next flush of at_cache.
+ */
+void stats_publish();
+/**
+ * Description: This function returns the number of events waiting on the
+ * EventBus, sampled by the host simulator to report queue depths.
+ * Pre: None
+ * Post: Returns the current depth of both lanes.
+ */
+size_t event_bus_depth();
+/**
+ * Description: This function returns the net detents the Rotary Encoder was
+ * decoded to since boot, checked by the host simulator against the traces it
+ * replays.
+ * Pre: None
+ * Post: Returns RE_DETENTS.
+ */
+int32_t re_detents_decoded();
+/**
+ * Description: This function stops the monitor and the network task, so
+ * neither runs while the host program exits and the fakes they use are
+ * destroyed.
+ * Pre: Called by the host entry points before main returns.
+ * Post: Neither task runs.
+ */
+void network_stop();
+
+/**
+ * Description: This function is called by timer_wheel when a timer is due
+ * and adds TIMER_DUE for it. A timer that is due again before its last
+ * TIMER_DUE was handled has waited a whole period behind other events, its
+ * work is done right away instead.
+ * Pre: None
+ * Post: Event is added to EventBus or the work of the timer is done.
+ */
+void timer_fired(int id, bool overrun);
+/**
+ * Description: This function does the work of a timer that is due, unless it
+ * was already done for this deadline.
+ * Pre: The payload is a TimerId.
+ * Post: app_events_key is read or telemetry_key is set, the jitter of the
+ * timer is recorded.
+ */
+void timer_is_due(const Message& message);
+/**
+ * Description: This function does the work of a timer.
+ * Pre: None
+ * Post: Same as timer_is_due()
  */
-void door_close_by_20();
+void timer_run(int id);
 
 /**
  * Description: This function is responsible to show the message on LCD that
- * displays the current state of the door.
+ * displays the current state of the door SELECTED_DOOR, with its number if
+ * there is more than one door.
  * Pre:
- * Post: The LCD module will have the DOOR_STATUS displayed in a Formatted message.
+ * Post: lcd_frame will have the status drawn in a Formatted message, the
+ * LCD module shows it with the next refresh.
  */
 void lcd_show_door_stat();
 /**
  * Description: This function is responsible to show the message on LCD that
- * displays the current percentage the door is Open when RE_STATUS is set to
- * REStatus:change
+ * displays the current percentage the door SELECTED_DOOR is Open when
+ * RE_STATUS is set to REStatus:change
  * Pre:
- * Post:
+ * Post: lcd_frame will have the percentage drawn, the LCD module shows it
+ * with the next refresh.
  */
 void lcd_show_re_stat();
 
 /**
  * Description: This function is responisble to calling the proceduers that
- * will update the AtSign secondary server with the current status of the Door.
+ * will update the AtSign secondary server with the current status of every Door.
  * Pre:
  * Post: The remote AtSign secondart server is updated with the current status of
- * the door.
+ * the doors.
  */
 void door_sync_status();
 /**
  * Description: This function is responisble to calling the proceduers that
- * will update the AtSign secondary server with the current value of the Rotary Encoder.
+ * will update the AtSign secondary server with the current value of the Rotary
+ * Encoder and the position of every door.
  * Pre:
  * Post: The remote AtSign secondart server is updated with the current value of RE.
  */
@@ -311,62 +1030,105 @@ void re_will_change();
  */
 void re_was_set();
 /**
- * Description: This function is responisble to add events that will close the door by 20%
- * and sync the information with AtSign secondary server.
+ * Description: This function is responisble to add events that will close the door by
+ * RE_SCRUB_PERCENT for every detent in the payload.
  * Pre: None
- * Post: Will add the events in EventBus neccsary to perform manual closing of door by 20%
+ * Post: Will add the DOOR_MOVE_TO in EventBus neccsary to perform manual closing of door
  */
-void re_value_increased();
+void re_value_increased(const Message& message);
 /**
- * Description: This function is responisble to add events that will open the door by 20%
- * and sync the information with AtSign secondary server.
+ * Description: This function is responisble to add events that will open the door by
+ * RE_SCRUB_PERCENT for every detent in the payload.
  * Pre: None
- * Post: Will add the events in EventBus neccsary to perform manual opening of door by 20%
+ * Post: Will add the DOOR_MOVE_TO in EventBus neccsary to perform manual opening of door
  */
-void re_value_decreased();
+void re_value_decreased(const Message& message);
 
 /**
- * The array that maps the EventHandler with the numeric value of the
- * enum Event so that is can be called with easily
+ * EventHandler<event> names the function that handles an Event. Every Event
+ * must have exactly one ON_EVENT, otherwise Event_Handlers does not compile.
  */
-static void (*(Event_Handlers[15]))() = {
-    door_sync_status,
-    re_sync_status,
-    door_will_open,
-    door_has_opened,
-    door_will_close,
-    door_has_closed,
-    door_is_halted,
-    door_open_by_20,
-    door_close_by_20,
-    lcd_show_door_stat,
-    lcd_show_re_stat,
-    re_will_change,
-    re_was_set,
-    re_value_increased,
-    re_value_decreased
-};
+template <size_t E>
+struct EventHandler;
+
+#define ON_EVENT(event, handler)                                 \
+    template <>                                                  \
+    struct EventHandler<event> {                                 \
+        static void handle(const Message& message)               \
+        {                                                        \
+            call_handler(handler, message);                      \
+        }                                                        \
+    }
+
+ON_EVENT(Event::SYNC_DOOR, door_sync_status);
+ON_EVENT(Event::SYNC_RE, re_sync_status);
+ON_EVENT(Event::DOOR_OPEN, door_will_open);
+ON_EVENT(Event::DOOR_OPENED, door_has_opened);
+ON_EVENT(Event::DOOR_CLOSE, door_will_close);
+ON_EVENT(Event::DOOR_CLOSED, door_has_closed);
+ON_EVENT(Event::DOOR_HALT, door_is_halted);
+ON_EVENT(Event::DOOR_OPEN_BY_20, door_open_by_20);
+ON_EVENT(Event::DOOR_CLOSE_BY_20, door_close_by_20);
+ON_EVENT(Event::LCD_SHOW_DOOR_STAT, lcd_show_door_stat);
+ON_EVENT(Event::LCD_SHOW_RE_STAT, lcd_show_re_stat);
+ON_EVENT(Event::RE_CHANGE, re_will_change);
+ON_EVENT(Event::RE_SET, re_was_set);
+ON_EVENT(Event::RE_INC, re_value_increased);
+ON_EVENT(Event::RE_DEC, re_value_decreased);
+ON_EVENT(Event::DOOR_MOVED, door_has_moved);
+ON_EVENT(Event::NET_COMPLETED, net_request_completed);
+ON_EVENT(Event::APP_E_NOTIFIED, app_event_notified);
+ON_EVENT(Event::STATS_DUMP, stats_dump);
+ON_EVENT(Event::DOOR_MOVE_TO, door_will_move_to);
+ON_EVENT(Event::TIMER_DUE, timer_is_due);
+
+/**
+ * The table that maps the numeric value of the enum Event to its handler,
+ * generated at compile time from the ON_EVENT list above.
+ */
+static constexpr std::array<EventHandlerFn<Message>, EVENT_COUNT> Event_Handlers
+    = dispatch_table<Message, EventHandler, EVENT_COUNT>();
+
+/**
+ * Per kind of event, the microseconds from being added to the EventBus until
+ * its handler started, and the microseconds its handler ran for.
+ */
+static LatencyHistogram event_wait[EVENT_COUNT];
+static LatencyHistogram event_run[EVENT_COUNT];
 
 //-------------- Arduino Setup Handler ------------------------------------------//
 
 void setup()
 {
-    // Initialize the AtSign's
-    const auto* chip = new AtSign("@moralbearbanana");
-    const auto* java = new AtSign("@batmanariesbanh");
-
-    // Read the encryption and decryption keys
-    const auto keys = keys_reader::read_keys(*chip);
+    unsigned long boot_started = micros();
+
+    // Read the encryption and decryption keys, from the copy kept in flash
+    // after the keys file was parsed the first time
+    KeyMap keys;
+    BOOT_KEYS_CACHED = key_store_load(CHIP_ATSIGN, keys);
+    if (!BOOT_KEYS_CACHED) {
+        keys = keys_reader::read_keys(chip_atsign);
+        key_store_save(CHIP_ATSIGN, keys);
+    }
+    BOOT_KEYS_MICROS = micros() - boot_started;
 
-    at_client = new AtClient(*chip, keys);
+    at_client = new (at_client_storage) AtClient(chip_atsign, keys);
 
     // Wifi connect and pkam authenticate into AtSign secondary Server
-    at_client->pkam_authenticate("hotspot", "12345678");
+    at_client->pkam_authenticate(WIFI_SSID, WIFI_PASSWORD);
 
-    app_events_key = new AtKey("app_e", java, chip);
-    event_bus_key = new AtKey("event_bus", chip, java);
-    door_status_key = new AtKey("door_status", chip, java);
-    re_value_key = new AtKey("re_value", chip, java);
+    // The client Application tokens are derived from the time of day
+    wall_clock_start();
+
+    // From here on at_client is only used by the network task
+    net_worker.start(at_client, WIFI_SSID, WIFI_PASSWORD, net_worker_completed);
+    app_monitor.start(monitor_transport(), "app_e", app_monitor_notified);
+
+    // Stamp every event so the time it waits on the EventBus can be measured
+    events.set_clock(micros);
+    log_ring.set_clock(micros);
+
+    Serial.begin(115200);
 
     // Configure the Arduino Pins and attach the Interrupt Handlers
 
@@ -378,124 +1140,213 @@ void setup()
 
     pinMode(RE_CLK, INPUT);
     pinMode(RE_DAT, INPUT);
-    attachInterrupt(digitalPinToInterrupt(RE_CLK), RERotateHandler, FALLING);
+    attachInterrupt(digitalPinToInterrupt(RE_CLK), RERotateHandler, CHANGE);
+    attachInterrupt(digitalPinToInterrupt(RE_DAT), RERotateHandler, CHANGE);
+
+    // Sleep while there is nothing to do, a touch, a press or a turn of the
+    // Rotary Encoder wakes the device
+    idle_start();
+    idle_wake_on(TOUCH_SENSOR, RISING);
+    idle_wake_on(RE_BUTTON, RISING);
+    idle_wake_on(RE_CLK, CHANGE);
 
     // Start the LCD
     lcd.begin(LCD_WIDTH, LCD_HEIGHT);
-    // Start the Servo
-    servo.attach(SERVO);
+    // Start the Servos
+    for (Door& door : doors) {
+        door.servo.attach(door.servo_pin);
+    }
 
-    // Default values on AtSign secondary server
-    at_client->put_ak(*event_bus_key, "");
-    at_client->put_ak(*door_status_key, to_string(DoorStatus::closed));
-    at_client->put_ak(*re_value_key, to_string(RE_VALUE));
+    for (Door& door : doors) {
+        at_cache.track(&door.status_key);
+        at_cache.track(&door.re_value_key);
+        at_cache.track(&door.position_key);
+    }
+    at_cache.track(&telemetry_key);
+    at_cache.track(&app_ack_key);
+    at_cache.track(&door_cycles_key);
+
+    // Carry on from the snapshot of the last boot, without one the doors
+    // start closed
+    DeviceState state;
+    BOOT_WARM = device_state.load(state);
+    if (BOOT_WARM) {
+        device_state_restore(state);
+    }
+    // The cycles that were not uploaded before the reboot still are
+    cycle_log.load();
+
+    // Values on AtSign secondary server, written in one flush. After a warm
+    // boot only what changed since the snapshot is written, and what the
+    // server has is read back in case it changed while the device was off.
+    for (Door& door : doors) {
+        at_cache.set(&door.status_key, (long)door.status);
+        at_cache.set(&door.re_value_key, (long)door.re_value);
+        at_cache.set(&door.position_key, (long)door.position);
+    }
+    at_cache.flush(net_worker, millis());
+    if (BOOT_WARM) {
+        for (Door& door : doors) {
+            net_worker.post_get(&door.status_key);
+            net_worker.post_get(&door.re_value_key);
+            net_worker.post_get(&door.position_key);
+        }
+    }
+
+    // Syncs and redraws read the current state when they are handled, so a
+    // repeat of one that is still pending can be folded into it. Both LCD
+    // screens draw over each other and share a group.
+    events.set_idempotent(Event::SYNC_DOOR, Event::SYNC_DOOR);
+    events.set_idempotent(Event::SYNC_RE, Event::SYNC_RE);
+    events.set_idempotent(Event::LCD_SHOW_DOOR_STAT, Event::LCD_SHOW_DOOR_STAT);
+    events.set_idempotent(Event::LCD_SHOW_RE_STAT, Event::LCD_SHOW_DOOR_STAT);
+    events.set_idempotent(Event::NET_COMPLETED, Event::NET_COMPLETED);
+    events.set_idempotent(Event::APP_E_NOTIFIED, Event::APP_E_NOTIFIED);
+
+    // Halts are handled before anything else, door movement before the LCD,
+    // and the LCD before talking to the AtSign secondary server
+    events.set_priority(Event::DOOR_HALT, Priority::safety);
+    events.set_priority(Event::DOOR_OPEN, Priority::motion);
+    events.set_priority(Event::DOOR_OPENED, Priority::motion);
+    events.set_priority(Event::DOOR_CLOSE, Priority::motion);
+    events.set_priority(Event::DOOR_CLOSED, Priority::motion);
+    events.set_priority(Event::DOOR_OPEN_BY_20, Priority::motion);
+    events.set_priority(Event::DOOR_CLOSE_BY_20, Priority::motion);
+    events.set_priority(Event::DOOR_MOVE_TO, Priority::motion);
+    events.set_priority(Event::DOOR_MOVED, Priority::motion);
+    events.set_priority(Event::RE_INC, Priority::motion);
+    events.set_priority(Event::RE_DEC, Priority::motion);
+    events.set_priority(Event::LCD_SHOW_DOOR_STAT, Priority::ui);
+    events.set_priority(Event::LCD_SHOW_RE_STAT, Priority::ui);
+    events.set_priority(Event::RE_CHANGE, Priority::ui);
+    events.set_priority(Event::RE_SET, Priority::ui);
+    events.set_priority(Event::STATS_DUMP, Priority::ui);
+    events.set_priority(Event::SYNC_DOOR, Priority::sync);
+    events.set_priority(Event::SYNC_RE, Priority::sync);
+    events.set_priority(Event::NET_COMPLETED, Priority::sync);
+    events.set_priority(Event::APP_E_NOTIFIED, Priority::sync);
+    events.set_priority(Event::TIMER_DUE, Priority::sync);
+
+    // Periodic work, first due one period from now
+    timer_wheel.start(millis());
+    timer_wheel.schedule(TimerId::app_e_poll, APP_E_POLL_MS, APP_E_POLL_MS, millis());
+    if (TELEMETRY_PUBLISH_MS > 0) {
+        timer_wheel.schedule(TimerId::telemetry, TELEMETRY_PUBLISH_MS, TELEMETRY_PUBLISH_MS, millis());
+    }
 
     // add event on EventBus to show the default door state
     events.add(Event::LCD_SHOW_DOOR_STAT);
-}
 
-// variables used to track Timers.
-
-static volatile unsigned long APP_E_TIME = millis();
-static volatile unsigned long TKN_TIME = millis();
-static int tkn = -1;
+    BOOT_MICROS = micros() - boot_started;
+    idle_stats.start(micros());
+}
 
 //-------------- Event Handlers ------------------------------------------//
 
 void loop()
 {
-    if (events.empty()) {
+    // Move the doors that are due, this never blocks
+    door_motion_tick();
 
-        // At every 30 second interval update the AtSign secondary server with
-        // a new random token
-        if (millis() - TKN_TIME > 30000) {
-            tkn = rand() % 100;
-            at_client->put_ak(*event_bus_key, std::to_string(tkn));
+    // Add the work of the timers that are due
+    timer_wheel.advance(millis(), timer_fired);
 
-            TKN_TIME = millis();
-        }
+    // Turn what the Rotary Encoder did since the last iteration into one event
+    re_rotation_drain();
 
-        // At every 15 second interval read the AtSign secondary server
-        // to see if an Application event has occured and verify that the
-        // token is within the timeframe
-        if (millis() - APP_E_TIME > 15000) {
-            string data = at_client->get_ak(*app_events_key);
-            std::cout << "\n\n\n\nData: " << data << "\n\n\n\n";
-
-            if (!data.empty() && data != " ") {
-                int pos = data.find('z');
-                int event_id = stoi(data.substr(0, pos));
-                int r_tkn = stoi(data.substr(pos + 1, data.length()));
-
-                std::cout << "\n\n\n\n\n";
-                std::cout << "event_id: " << event_id << '\n';
-                std::cout << "tkn: " << r_tkn << '\n';
-                std::cout << "\n\n\n\n\n";
-
-                if (r_tkn == tkn) {
-
-                    if (event_id == 6) {
-                        events.sos(Event::DOOR_HALT);
-                    } else if (event_id == 2) {
-                        events.add(Event::DOOR_OPEN);
-                    } else if (event_id == 4) {
-                        events.add(Event::DOOR_CLOSE);
-                    }
-                }
-            }
+    // Send what the LCD handlers drew since the last refresh
+    if (lcd_frame.flush_due(millis(), LCD_REFRESH_MS)) {
+        lcd_frame.flush(lcd, millis());
+    }
 
-            APP_E_TIME = millis();
-        }
+    // Write the values that changed since the last flush, and again the ones
+    // whose write was never acknowledged
+    at_cache.expire(millis(), AT_CACHE_IN_FLIGHT_MS);
+    if (at_cache.flush_due(millis(), AT_CACHE_FLUSH_MS)) {
+        at_cache.flush(net_worker, millis());
+    }
 
+    // Bring the snapshot in flash up to date while the doors stand still,
+    // it is only written when something changed
+    if (!doors_moving() && device_state.save_due(millis(), DEVICE_STATE_SAVE_MS)) {
+        device_state.save(device_state_capture(), millis());
+    }
+    if (!doors_moving() && cycle_log.save_in(millis(), CYCLE_LOG_SAVE_MS) == 0) {
+        cycle_log.save(millis());
+    }
+
+    if (Serial.available() > 0 && Serial.read() == STATS_DUMP_KEY) {
+        events.add(Event::STATS_DUMP);
+    }
+
+    if (events.empty()) {
+        // Nothing to handle, upload the door cycles, print the log and wait
+        // for the next deadline or an input
+        cycle_upload();
+        log_drain();
+        idle_until_due();
         return;
     }
 
     // Read the current event that needs to be performed
 
-    Event event = events.current();
+    Message message = events.current();
+    uint32_t added_at = events.current_added_at();
 
-    // Invoke the Handler
+    // Mark completed and remove before invoking the handler so that the
+    // handler sees the events that follow it at the front of the EventBus
 
-    Event_Handlers[event]();
+    events.current_completed();
 
-    // Mark completed and remove
+    // Invoke the Handler and record how long the event waited and ran
 
-    events.current_completed();
+    uint32_t started_at = micros();
+    HANDLED_ADDED_AT = added_at;
+    Event_Handlers[message.type](message);
+    event_wait[message.type].record(started_at - added_at);
+    event_run[message.type].record((uint32_t)micros() - started_at);
 }
 
 void TouchInterruptHandler()
 {
-    switch (DOOR_STATUS) {
+    idle_input(EventSource::touch, TOUCH_SENSOR);
+
+    uint8_t selected = SELECTED_DOOR;
+    Door& door = doors[selected];
+
+    switch (door.status) {
     case DoorStatus::closed: {
-        events.add(Event::DOOR_OPEN);
+        events.add(Message(Event::DOOR_OPEN, 0, EventSource::touch, selected));
         break;
     }
     case DoorStatus::opened: {
-        events.add(Event::DOOR_CLOSE);
+        events.add(Message(Event::DOOR_CLOSE, 0, EventSource::touch, selected));
         break;
     }
     case DoorStatus::opening: {
-        events.sos(Event::DOOR_HALT);
+        door.halt_requested_at = millis();
+        events.sos(Message(Event::DOOR_HALT, 0, EventSource::touch, selected));
         break;
     }
     case DoorStatus::closing: {
-        events.sos(Event::DOOR_HALT);
+        door.halt_requested_at = millis();
+        events.sos(Message(Event::DOOR_HALT, 0, EventSource::touch, selected));
         break;
     }
     }
 }
 
-static volatile unsigned long RE_TIME = millis();
-
 void REButtonHandler()
 {
+    idle_input(EventSource::encoder, RE_BUTTON);
+
     switch (RE_STATUS) {
     case REStatus::set: {
-        events.add(RE_CHANGE);
+        events.add(Message(Event::RE_CHANGE, 0, EventSource::encoder));
         break;
     }
     case REStatus::change: {
-        events.add(RE_SET);
+        events.add(Message(Event::RE_SET, 0, EventSource::encoder));
         break;
     }
     }
@@ -503,144 +1354,314 @@ void REButtonHandler()
 
 void RERotateHandler()
 {
-    if (RE_STATUS != REStatus::change) {
+    idle_input(EventSource::encoder, RE_CLK);
+    re_decoder.update(digitalRead(RE_CLK), digitalRead(RE_DAT));
+}
+
+void idle_input(EventSource source, uint8_t pin)
+{
+    idle_stats.input(source, micros());
+    idle_wake_from_isr(pin);
+}
+
+void re_rotation_drain()
+{
+    int32_t detents = re_decoder.take();
+    if (detents == 0) {
         return;
     }
-    if (millis() - RE_TIME < 1000) {
+    RE_DETENTS += detents;
+
+    if (RE_STATUS != REStatus::change) {
+        // The dial picks the door the panel acts on while no door is scrubbed
+        if (DOOR_COUNT > 1) {
+            SELECTED_DOOR = (uint8_t)(((SELECTED_DOOR + detents) % DOOR_COUNT + DOOR_COUNT) % DOOR_COUNT);
+            events.add(Event::LCD_SHOW_DOOR_STAT);
+        }
         return;
     }
 
-    RE_TIME = millis();
-
-    if (digitalRead(RE_DAT)) {
-        events.add(Event::RE_INC);
+    if (detents > 0) {
+        events.add(Message(Event::RE_INC, (int16_t)detents, EventSource::encoder, SELECTED_DOOR));
     } else {
-        events.add(Event::RE_DEC);
+        events.add(Message(Event::RE_DEC, (int16_t)-detents, EventSource::encoder, SELECTED_DOOR));
     }
 }
 
-void door_will_open()
+void door_will_open(const Message& message)
 {
-    std::cout << "DOOR IS OPENING\n";
-    DOOR_STATUS = DoorStatus::opening;
+    Door& door = doors[message.door];
+    LOG_INFO(log_door_opening, message.door + 1, message.source);
+    door.status = DoorStatus::opening;
     events.add(Event::LCD_SHOW_DOOR_STAT);
     events.add(Event::SYNC_DOOR);
 
-    for (int i = 0; i < RE_VALUE; i++) {
-        events.add(Event::DOOR_OPEN_BY_20);
-    }
-    events.add(Event::DOOR_OPENED);
+    door_cycle_begin(message, true);
+    door_move(message.door, SERVO_ANGLE_MAX, Event::DOOR_OPENED);
 }
 
-void door_has_opened()
+void door_has_opened(const Message& message)
 {
-    std::cout << "DOOR IS OPENED\n";
-    DOOR_STATUS = DoorStatus::opened;
+    Door& door = doors[message.door];
+    LOG_INFO(log_door_opened, message.door + 1, 0);
+    door.status = DoorStatus::opened;
     events.add(Event::LCD_SHOW_DOOR_STAT);
     events.add(Event::SYNC_DOOR);
-    RE_VALUE = RE_VALUE_MIN;
+    door.re_value = RE_VALUE_MIN;
     events.add(Event::SYNC_RE);
+    door_cycle_end(message.door, DoorCycleEnd::cycle_opened);
 }
 
-void door_will_close()
+void door_will_close(const Message& message)
 {
-    std::cout << "DOOR IS CLOSING\n";
-    DOOR_STATUS = DoorStatus::closing;
+    Door& door = doors[message.door];
+    LOG_INFO(log_door_closing, message.door + 1, message.source);
+    door.status = DoorStatus::closing;
     events.add(Event::LCD_SHOW_DOOR_STAT);
     events.add(Event::SYNC_DOOR);
-    for (int i = RE_VALUE; i < RE_VALUE_MAX; i++) {
-        events.add(Event::DOOR_CLOSE_BY_20);
-    }
-    events.add(Event::DOOR_CLOSED);
+
+    door_cycle_begin(message, false);
+    door_move(message.door, SERVO_ANGLE_MIN, Event::DOOR_CLOSED);
 }
 
-void door_has_closed()
+void door_has_closed(const Message& message)
 {
-    std::cout << "DOOR IS CLOSED\n";
-    DOOR_STATUS = DoorStatus::closed;
+    Door& door = doors[message.door];
+    LOG_INFO(log_door_closed, message.door + 1, 0);
+    door.status = DoorStatus::closed;
     events.add(Event::LCD_SHOW_DOOR_STAT);
     events.add(Event::SYNC_DOOR);
-    RE_VALUE = RE_VALUE_MAX;
+    door.re_value = RE_VALUE_MAX;
     events.add(Event::SYNC_RE);
+    door_cycle_end(message.door, DoorCycleEnd::cycle_closed);
 }
 
-void door_is_halted()
+void door_is_halted(const Message& message)
 {
-    std::cout << "DOOR HALTED\n";
-    if (events.current() == Event::DOOR_HALT) {
-        events.current_completed();
-    }
-
-    Event door_movement_type;
-
-    if (DOOR_STATUS == DoorStatus::closing) {
-        door_movement_type = Event::DOOR_CLOSE_BY_20;
-    } else if (DOOR_STATUS == DoorStatus::opening) {
-        door_movement_type = Event::DOOR_OPEN_BY_20;
-    }
+    Door& door = doors[message.door];
+    door.motion.halt(door.halt_requested_at, millis());
+    LOG_INFO(log_door_halted, message.door + 1, (int32_t)door.motion.last_halt_latency());
 
-    while (events.current() == door_movement_type) {
-        events.current_completed();
-    }
+    // Every motion of this door that was waiting, and the arrival of the one
+    // that was halted, is void now. This costs the same however many are
+    // waiting, the other doors keep theirs.
+    events.cancel_level(Priority::motion, message.door);
 
+    // The door stopped part way, report it as opened unless it is fully closed
+    door.status = door.servo_angle > SERVO_ANGLE_MIN ? DoorStatus::opened : DoorStatus::closed;
+    events.add(Event::LCD_SHOW_DOOR_STAT);
     events.add(Event::SYNC_DOOR);
     events.add(Event::SYNC_RE);
+    door_cycle_end(message.door, DoorCycleEnd::cycle_halted);
 }
 
 void door_sync_status()
 {
-    at_client->put_ak(*door_status_key, std::to_string(DOOR_STATUS));
+    // A change of the door status is a state transition, write everything
+    // that is dirty now instead of waiting for the next flush. The doors that
+    // did not change are not written again.
+    for (Door& door : doors) {
+        at_cache.set(&door.status_key, (long)door.status);
+    }
+    at_cache.flush(net_worker, millis());
 }
 
 void re_sync_status()
 {
-    std::cout << "\n\n\n\nRE_VALUE: " << RE_VALUE << "\n\n\n\n";
-    at_client->put_ak(*re_value_key, std::to_string(RE_VALUE));
+    for (size_t i = 0; i < doors.size(); i++) {
+        Door& door = doors[i];
+        LOG_DEBUG(log_re_value, (int32_t)i + 1, door.re_value);
+        at_cache.set(&door.re_value_key, (long)door.re_value);
+        at_cache.set(&door.position_key, (long)door.position);
+    }
 }
 
 void lcd_show_door_stat()
 {
-    const static std::map<int, std::string> DoorStatusStrings = {
-        { DoorStatus::opened, " Opened " },
-        { DoorStatus::closed, " Closed " },
-        { DoorStatus::opening, "Opening " },
-        { DoorStatus::closing, "Closing " }
+    // Indexed by DoorStatus
+    static const char* const DoorStatusStrings[] = {
+        " Opened ",
+        " Closed ",
+        "Opening ",
+        "Closing "
     };
 
-    lcd.setCursor(0, 0);
-    lcd.write("  Door  ");
-    std::string message = DoorStatusStrings.at(DOOR_STATUS);
-    lcd.setCursor(0, 1);
-    lcd.write(message.c_str());
+    uint8_t selected = SELECTED_DOOR;
+    if (DOOR_COUNT > 1) {
+        lcd_frame.write(0, 0, " Door   ");
+        lcd_frame.write_number(0, 6, 1, selected + 1);
+    } else {
+        lcd_frame.write(0, 0, "  Door  ");
+    }
+    lcd_frame.write(1, 0, DoorStatusStrings[doors[selected].status]);
 }
 
 void lcd_show_re_stat()
 {
-    lcd.setCursor(0, 0);
-    lcd.write("DoorOpen");
-    lcd.setCursor(0, 1);
-    std::string amount = std::to_string(RE_VALUE * RE_STEP_SIZE);
-    while (amount.size() <= 3) {
-        amount = ' ' + amount;
+    lcd_frame.write(0, 0, "DoorOpen");
+    lcd_frame.write_number(1, 0, 5, 100 - doors[SELECTED_DOOR].position);
+    lcd_frame.write(1, 5, " % ");
+}
+
+void door_open_by_20(const Message& message)
+{
+    Door& door = doors[message.door];
+    door_move(message.door, door.motion.target_angle() + message.value * (SERVO_ANGLE_MAX / RE_VALUE_MAX), Event::DOOR_MOVED);
+}
+
+void door_close_by_20(const Message& message)
+{
+    Door& door = doors[message.door];
+    door_move(message.door, door.motion.target_angle() - message.value * (SERVO_ANGLE_MAX / RE_VALUE_MAX), Event::DOOR_MOVED);
+}
+
+void door_has_moved(const Message& message)
+{
+    Door& door = doors[message.door];
+    bool cycling = door.status == DoorStatus::opening || door.status == DoorStatus::closing;
+
+    // A move to a position part way stops like a halt. A scrub with the
+    // Rotary Encoder does not announce itself, but can open a closed door or
+    // close an opened one all the same.
+    DoorStatus status = door.servo_angle > SERVO_ANGLE_MIN ? DoorStatus::opened : DoorStatus::closed;
+    if (cycling || status != door.status) {
+        door.status = status;
+        events.add(Event::LCD_SHOW_DOOR_STAT);
+        events.add(Event::SYNC_DOOR);
+    }
+    if (cycling) {
+        door_cycle_end(message.door, DoorCycleEnd::cycle_stopped);
+    } else if (RE_STATUS == REStatus::change) {
+        // Drawn last, the percentage stays on the LCD while scrubbing
+        events.add(Event::LCD_SHOW_RE_STAT);
+    }
+    events.add(Event::SYNC_RE);
+}
+
+void door_will_move_to(const Message& message)
+{
+    Door& door = doors[message.door];
+    int percent = message.value < 0 ? 0 : message.value > 100 ? 100 : message.value;
+    int target = SERVO_ANGLE_MIN + percent * (SERVO_ANGLE_MAX - SERVO_ANGLE_MIN) / 100;
+
+    if (target == door.motion.target_angle()) {
+        return;
+    }
+
+    if (message.source == EventSource::encoder) {
+        door_move(message.door, target, Event::DOOR_MOVED);
+        return;
+    }
+
+    LOG_INFO(log_door_moving_to, message.door + 1, percent);
+    door.status = target > door.servo_angle ? DoorStatus::opening : DoorStatus::closing;
+    events.add(Event::LCD_SHOW_DOOR_STAT);
+    events.add(Event::SYNC_DOOR);
+
+    door_cycle_begin(message, door.status == DoorStatus::opening);
+    door_move(message.door, target, target == SERVO_ANGLE_MAX ? Event::DOOR_OPENED
+            : target == SERVO_ANGLE_MIN                       ? Event::DOOR_CLOSED
+                                                              : Event::DOOR_MOVED);
+}
+
+void door_cycle_begin(const Message& message, bool opening)
+{
+    Door& door = doors[message.door];
+    door_cycle_end(message.door, DoorCycleEnd::cycle_superseded);
+
+    door.cycle.started_at = wall_clock_seconds();
+    door.cycle.latency_us = (uint32_t)micros() - HANDLED_ADDED_AT;
+    door.cycle.door = message.door;
+    door.cycle.source = message.source;
+    door.cycle.opening = opening;
+    door.cycle_started_at = millis();
+    door.cycling = true;
+}
+
+void door_cycle_end(uint8_t index, DoorCycleEnd end)
+{
+    Door& door = doors[index];
+    if (!door.cycling) {
+        return;
+    }
+    door.cycling = false;
+    door.cycle.duration_ms = (uint32_t)(millis() - door.cycle_started_at);
+    door.cycle.end = end;
+    cycle_log.add(door.cycle, millis());
+}
+
+void cycle_upload()
+{
+    // Not settled while the last upload is dirty or in flight. A failed write
+    // is dirty again and one stuck in flight is expired, either way the same
+    // records are written again, so this can not wait for good.
+    if (!at_cache.settled(&door_cycles_key)) {
+        return;
+    }
+    // The last upload is on the server, the records after it go next
+    cycle_log.uploaded();
+    if (cycle_log.upload_in(millis(), CYCLE_UPLOAD_MS) != 0) {
+        return;
+    }
+
+    char value[NET_VALUE_MAX];
+    if (cycle_log.take_upload(value, sizeof(value)) > 0) {
+        at_cache.set(&door_cycles_key, value);
+    }
+}
+
+/**
+ * The correlation ID of the current motion of a door.
+ */
+static uint8_t door_correlation(uint8_t index)
+{
+    return (uint8_t)(index * MOTION_IDS + doors[index].motion_id);
+}
+
+void door_move(uint8_t index, int target_angle, Event done)
+{
+    Door& door = doors[index];
+    events.cancel_correlation(door_correlation(index));
+    door.motion_id = door.motion_id % (MOTION_IDS - 1) + 1;
+    door.motion_done = done;
+
+    door.motion.move_to(target_angle, millis());
+    // Already there, nothing will arrive to settle the status
+    if (!door.motion.is_moving()) {
+        events.add(Message(done, 0, EventSource::device, index, door_correlation(index)));
     }
-    std::string v = " " + amount + " %  ";
-    lcd.write(v.c_str());
 }
 
-void door_open_by_20()
+void door_motion_tick()
 {
-    SERVO_ANGLE = SERVO_ANGLE + (int)(180 / RE_VALUE_MAX);
-    servo.write(SERVO_ANGLE);
-    delay(1000);
-    RE_VALUE -= 1;
+    const int degrees_per_step = SERVO_ANGLE_MAX / RE_VALUE_MAX;
+
+    for (size_t i = 0; i < doors.size(); i++) {
+        Door& door = doors[i];
+        DoorMotion::TickResult result = door.motion.tick(millis());
+        if (result == DoorMotion::TickResult::idle) {
+            continue;
+        }
+
+        door.servo_angle = door.motion.current_angle();
+        door.servo.write(door.servo_angle);
+        door.re_value = RE_VALUE_MAX - (door.servo_angle + degrees_per_step / 2) / degrees_per_step;
+        door.position = (door.servo_angle - SERVO_ANGLE_MIN) * 100 / (SERVO_ANGLE_MAX - SERVO_ANGLE_MIN);
+
+        if (result == DoorMotion::TickResult::arrived) {
+            events.add(Message(door.motion_done, 0, EventSource::device, (uint8_t)i, door_correlation((uint8_t)i)));
+        }
+    }
 }
 
-void door_close_by_20()
+bool doors_moving()
 {
-    SERVO_ANGLE = SERVO_ANGLE - (int)(180 / RE_VALUE_MAX);
-    servo.write(SERVO_ANGLE);
-    delay(1000);
-    RE_VALUE += 1;
+    for (const Door& door : doors) {
+        if (door.motion.is_moving()) {
+            return true;
+        }
+    }
+    return false;
 }
 
 void re_will_change()
@@ -655,20 +1676,509 @@ void re_was_set()
     events.add(Event::LCD_SHOW_DOOR_STAT);
 }
 
-void re_value_increased()
+/**
+ * The percentage open the motion of a door is moving to, or is at when idle.
+ */
+static int door_target_position(const Door& door)
 {
-    if (RE_VALUE < RE_VALUE_MAX) {
-        events.add(Event::DOOR_CLOSE_BY_20);
-        events.add(Event::LCD_SHOW_RE_STAT);
-        events.add(Event::SYNC_RE);
+    return (door.motion.target_angle() - SERVO_ANGLE_MIN) * 100 / (SERVO_ANGLE_MAX - SERVO_ANGLE_MIN);
+}
+
+void re_value_increased(const Message& message)
+{
+    int target = door_target_position(doors[message.door]);
+    if (target > 0) {
+        events.add(Message(Event::DOOR_MOVE_TO, target - message.value * RE_SCRUB_PERCENT, message.source, message.door));
     }
 }
 
-void re_value_decreased()
+void re_value_decreased(const Message& message)
 {
-    if (RE_VALUE > RE_VALUE_MIN) {
-        events.add(Event::DOOR_OPEN_BY_20);
-        events.add(Event::LCD_SHOW_RE_STAT);
-        events.add(Event::SYNC_RE);
+    int target = door_target_position(doors[message.door]);
+    if (target < 100) {
+        events.add(Message(Event::DOOR_MOVE_TO, target + message.value * RE_SCRUB_PERCENT, message.source, message.door));
+    }
+}
+
+void event_bus_report()
+{
+    std::cout << "EventBus overflows: " << events.overflow_count()
+              << " cancelled: " << events.cancelled_count() << '\n';
+    std::cout << "Network writes saved: "
+              << events.coalesced_count(Event::SYNC_DOOR) + events.coalesced_count(Event::SYNC_RE) << '\n';
+    std::cout << "LCD redraws saved: "
+              << events.coalesced_count(Event::LCD_SHOW_DOOR_STAT) + events.coalesced_count(Event::LCD_SHOW_RE_STAT) << '\n';
+    std::cout << "Network requests performed: " << net_worker.performed_count()
+              << " dropped: " << net_worker.request_dropped_count()
+              << " completions held: " << net_worker.completion_held_count() << '\n';
+    std::cout << "Network disconnects: " << net_worker.disconnect_count()
+              << " reconnect attempts: " << net_worker.reconnect_attempt_count()
+              << " reconnect ms p50: " << net_worker.reconnect_millis().percentile(50)
+              << " p99: " << net_worker.reconnect_millis().percentile(99)
+              << " outbox depth: " << at_cache.pending_count()
+              << " max: " << at_cache.pending_high_water() << '\n';
+    std::cout << "Monitor notifications: " << app_monitor.received_count()
+              << " dropped: " << app_monitor.dropped_count()
+              << " connects: " << app_monitor.connect_count() << '\n';
+    std::cout << "AtKey values set: " << at_cache.set_count()
+              << " written: " << at_cache.write_count()
+              << " avoided: " << at_cache.avoided_count()
+              << " failed: " << at_cache.failed_count()
+              << " expired: " << at_cache.expired_count() << '\n';
+    std::cout << "Rotary Encoder detents: " << RE_DETENTS
+              << " invalid transitions: " << re_decoder.invalid_count() << '\n';
+    std::cout << "LCD refreshes: " << lcd_frame.flush_count()
+              << " cells sent: " << lcd_frame.sent_count()
+              << " unchanged: " << lcd_frame.skipped_count() << '\n';
+    std::cout << "App commands applied: " << APP_COMMANDS_APPLIED
+              << " repeated: " << APP_COMMANDS_REPEATED
+              << " batches rejected: " << APP_BATCHES_REJECTED
+              << " tokens rejected: " << APP_TOKENS_REJECTED
+              << " replayed: " << APP_TOKENS_REPLAYED << '\n';
+    std::cout << "Door cycles recorded: " << cycle_log.recorded_count()
+              << " kept: " << cycle_log.size() << " (" << cycle_log.bytes_used() << " bytes)"
+              << " not uploaded: " << cycle_log.unsent()
+              << " dropped: " << cycle_log.dropped_count()
+              << " uploads: " << cycle_log.upload_count()
+              << " checkpoints: " << cycle_log.save_count() << '\n';
+    std::cout << "App polls: " << APP_E_POLLS
+              << " not read: " << APP_E_POLLS_NOT_READ
+              << " same value: " << APP_E_POLLS_SAME
+              << " monitor values: " << APP_E_MONITORED
+              << " same value: " << APP_E_MONITORED_SAME << '\n';
+    std::cout << "Boot ms: " << BOOT_MICROS / 1000.0
+              << " keys ms: " << BOOT_KEYS_MICROS / 1000.0 << (BOOT_KEYS_CACHED ? " (copy)" : " (file)")
+              << (BOOT_WARM ? " warm" : " cold")
+              << " snapshots saved: " << device_state.save_count()
+              << " unchanged: " << device_state.unchanged_count()
+              << " stale keys: " << at_cache.stale_count() << '\n';
+    std::cout << "Heap free: " << heap_free()
+              << " largest block: " << heap_largest_block()
+              << " least free: " << heap_min_free() << '\n';
+    std::cout << "Log records: " << log_ring.written_count()
+              << " dropped: " << log_ring.dropped_count()
+              << " high water: " << log_ring.high_water_mark() << '\n';
+}
+
+void net_worker_completed()
+{
+    events.add(Event::NET_COMPLETED);
+    idle_wake();
+}
+
+void net_request_completed()
+{
+    NetCompletion completion;
+
+    while (net_worker.take_completion(completion)) {
+        if (completion.op == NetOp::put) {
+            at_cache.acknowledge(completion);
+        } else if (completion.key == &app_events_key) {
+            if (completion.ok) {
+                app_event_polled(completion);
+            }
+        } else {
+            at_cache.reconcile(completion);
+        }
+    }
+}
+
+void app_event_polled(const NetCompletion& completion)
+{
+    APP_E_POLLS++;
+    if (completion.unchanged) {
+        APP_E_POLLS_NOT_READ++;
+        return;
     }
-}
\ No newline at end of file
+    APP_E_VERSION = completion.version;
+
+    if (!app_event_received(completion.value)) {
+        APP_E_POLLS_SAME++;
+    }
+}
+
+uint32_t app_value_hash(const char* data)
+{
+    uint32_t hash = 2166136261u;
+    for (; *data != '\0'; data++) {
+        hash = (hash ^ (uint8_t)*data) * 16777619u;
+    }
+    return hash != 0 ? hash : 1;
+}
+
+void app_monitor_notified()
+{
+    events.add(Event::APP_E_NOTIFIED);
+    idle_wake();
+}
+
+void app_event_notified()
+{
+    MonitorNotification notification;
+
+    while (app_monitor.take_notification(notification)) {
+        APP_E_MONITORED++;
+        if (!app_event_received(notification.value)) {
+            APP_E_MONITORED_SAME++;
+        }
+    }
+}
+
+bool app_event_received(const char* data)
+{
+    // The monitor and the poll can both deliver a value, it is handled once
+    // whichever comes first. A value of the legacy form carries no sequence
+    // number, handling it again would repeat its command.
+    uint32_t hash = app_value_hash(data);
+    if (hash == APP_E_HASH) {
+        return false;
+    }
+    APP_E_HASH = hash;
+
+    // Verify that the token is within the timeframe
+    LOG_DEBUG(log_app_data, (int32_t)strlen(data), data[0]);
+
+    if (data[0] == APP_BATCH_MARKER) {
+        AppBatch batch;
+        if (!AppBatch::decode(data, batch)) {
+            APP_BATCHES_REJECTED++;
+            LOG_WARN(log_app_batch_rejected, (int32_t)strlen(data), 0);
+            return true;
+        }
+        if (!app_token_valid((long)batch.token)) {
+            return true;
+        }
+        for (uint8_t i = 0; i < batch.count; i++) {
+            const AppCommand& command = batch.commands[i];
+            if (APP_SEQUENCE_KNOWN && !app_sequence_newer(command.sequence, APP_SEQUENCE)) {
+                APP_COMMANDS_REPEATED++;
+                continue;
+            }
+            APP_SEQUENCE = command.sequence;
+            APP_SEQUENCE_KNOWN = true;
+            APP_COMMANDS_APPLIED++;
+            app_command_apply(command.event, command.value, command.door);
+        }
+        if (APP_SEQUENCE_KNOWN) {
+            at_cache.set(&app_ack_key, (long)APP_SEQUENCE);
+            // A reboot must not apply the same commands again
+            device_state.save(device_state_capture(), millis());
+        }
+        return true;
+    }
+
+    const char* token = strchr(data, 'z');
+    if (token != nullptr) {
+        char* end;
+        int event_id = (int)strtol(data, &end, 10);
+
+        // A move carries the percentage as "<event_id>:<percent>z<token>"
+        int percent = 0;
+        if (*end == ':') {
+            percent = (int)strtol(end + 1, &end, 10);
+        }
+        if (end != token || end == data) {
+            return true;
+        }
+        long r_tkn = strtol(token + 1, &end, 10);
+        if (end == token + 1) {
+            return true;
+        }
+
+        LOG_DEBUG(log_app_command, event_id, percent);
+
+        if (!app_token_valid(r_tkn)) {
+            return true;
+        }
+        if (!app_replay_guard.take((uint32_t)r_tkn, event_id, percent, wall_clock_seconds())) {
+            APP_TOKENS_REPLAYED++;
+            LOG_WARN(log_app_token_replayed, (int32_t)r_tkn, event_id);
+            return true;
+        }
+        // Values of this form are for the first door
+        app_command_apply(event_id, percent, 0);
+    }
+    return true;
+}
+
+bool app_token_valid(long token)
+{
+    uint32_t now = wall_clock_seconds();
+    if (now == 0 || token < 0 || !app_token.verify((uint32_t)token, now)) {
+        APP_TOKENS_REJECTED++;
+        LOG_WARN(log_app_token_rejected, (int32_t)token, (int32_t)now);
+        return false;
+    }
+    return true;
+}
+
+void app_command_apply(int event_id, int value, uint8_t door)
+{
+    if (door >= DOOR_COUNT) {
+        return;
+    }
+
+    if (event_id == Event::DOOR_HALT) {
+        doors[door].halt_requested_at = millis();
+        door_is_halted(Message(Event::DOOR_HALT, 0, EventSource::app, door));
+    } else if (event_id == Event::DOOR_OPEN) {
+        events.add(Message(Event::DOOR_OPEN, 0, EventSource::app, door));
+    } else if (event_id == Event::DOOR_CLOSE) {
+        events.add(Message(Event::DOOR_CLOSE, 0, EventSource::app, door));
+    } else if (event_id == Event::DOOR_MOVE_TO) {
+        events.add(Message(Event::DOOR_MOVE_TO, (int16_t)value, EventSource::app, door));
+    }
+}
+
+void stats_dump()
+{
+    std::cout << "event  count  wait p50/p99/max us  run p50/p99/max us\n";
+    for (int i = 0; i < EVENT_COUNT; i++) {
+        if (event_run[i].count() == 0) {
+            continue;
+        }
+        std::cout << i << "  " << event_run[i].count() << "  "
+                  << event_wait[i].percentile(50) << '/' << event_wait[i].percentile(99) << '/' << event_wait[i].max() << "  "
+                  << event_run[i].percentile(50) << '/' << event_run[i].percentile(99) << '/' << event_run[i].max() << '\n';
+    }
+    std::cout << "EventBus high water: " << events.high_water_mark() << '\n';
+    std::cout << "timer  fired  overruns  missed  jitter p50/p99/max us\n";
+    for (int i = 0; i < TIMER_COUNT; i++) {
+        const LatencyHistogram& jitter = timer_wheel.jitter(i);
+        std::cout << TIMER_NAMES[i] << "  " << timer_wheel.fired_count(i) << "  "
+                  << timer_wheel.overrun_count(i) << "  " << timer_wheel.missed_count(i) << "  "
+                  << jitter.percentile(50) << '/' << jitter.percentile(99) << '/' << jitter.max() << '\n';
+    }
+
+    uint64_t idle_us = idle_stats.idle_micros();
+    uint64_t active_us = idle_stats.active_micros(micros());
+    std::cout << "idle ms: " << idle_us / 1000 << "  active ms: " << active_us / 1000 << "  idle "
+              << (idle_us + active_us > 0 ? 100.0 * idle_us / (idle_us + active_us) : 0.0) << '%'
+              << (idle_light_sleep() ? "  light sleep" : "  no light sleep") << '\n';
+    std::cout << "waits: " << idle_stats.sleep_count() << "  woken by input: " << idle_stats.woken_by_input()
+              << "  by task: " << idle_stats.woken_by_task() << '\n';
+    std::cout << "wake  count  latency p50/p99/max us\n";
+    for (int i = 0; i < IDLE_SOURCES; i++) {
+        const LatencyHistogram& latency = idle_stats.wake_latency_of(i);
+        if (latency.count() == 0) {
+            continue;
+        }
+        std::cout << EVENT_SOURCE_NAMES[i] << "  " << latency.count() << "  "
+                  << latency.percentile(50) << '/' << latency.percentile(99) << '/' << latency.max() << '\n';
+    }
+    event_bus_report();
+}
+
+void stats_publish()
+{
+    int worst_wait = 0;
+    int worst_run = 0;
+    for (int i = 1; i < EVENT_COUNT; i++) {
+        if (event_wait[i].max() > event_wait[worst_wait].max()) {
+            worst_wait = i;
+        }
+        if (event_run[i].max() > event_run[worst_run].max()) {
+            worst_run = i;
+        }
+    }
+
+    // d<high water>o<overflows>w<event>:<max wait us>r<event>:<max run us>
+    // h<free heap>l<largest free block>m<least free heap>
+    char value[NET_VALUE_MAX];
+    snprintf(value, sizeof(value), "d%uo%lu" "w%d:%lur%d:%lu" "h%ul%um%u",
+        (unsigned)events.high_water_mark(), (unsigned long)events.overflow_count(),
+        worst_wait, (unsigned long)event_wait[worst_wait].max(),
+        worst_run, (unsigned long)event_run[worst_run].max(),
+        (unsigned)heap_free(), (unsigned)heap_largest_block(), (unsigned)heap_min_free());
+    at_cache.set(&telemetry_key, value);
+}
+
+DeviceState device_state_capture()
+{
+    DeviceState state;
+    memset(&state, 0, sizeof(state));
+    state.app_sequence = APP_SEQUENCE;
+    state.app_sequence_known = APP_SEQUENCE_KNOWN;
+
+    long value;
+    if (at_cache.acked(&app_ack_key, value)) {
+        state.published |= DevicePublished::published_ack;
+        state.published_ack = (int32_t)value;
+    }
+
+    for (size_t i = 0; i < doors.size(); i++) {
+        const Door& door = doors[i];
+        DoorState& saved = state.doors[i];
+        saved.door_status = (uint8_t)door.status;
+        saved.re_value = (uint8_t)door.re_value;
+        saved.servo_angle = (int16_t)door.servo_angle;
+        saved.door_position = (int16_t)door.position;
+
+        if (at_cache.acked(&door.status_key, value)) {
+            saved.published |= DevicePublished::published_status;
+            saved.published_status = (int32_t)value;
+        }
+        if (at_cache.acked(&door.re_value_key, value)) {
+            saved.published |= DevicePublished::published_re;
+            saved.published_re = (int32_t)value;
+        }
+        if (at_cache.acked(&door.position_key, value)) {
+            saved.published |= DevicePublished::published_position;
+            saved.published_position = (int32_t)value;
+        }
+    }
+    return state;
+}
+
+void device_state_restore(const DeviceState& state)
+{
+    for (size_t i = 0; i < doors.size(); i++) {
+        Door& door = doors[i];
+        const DoorState& saved = state.doors[i];
+        door.motion.reset(saved.servo_angle);
+        door.servo_angle = door.motion.current_angle();
+        door.servo.write(door.servo_angle);
+        door.re_value = saved.re_value;
+        door.position = saved.door_position;
+
+        // A snapshot is taken while the doors stand still, a status of a door
+        // in motion can only come from a snapshot taken right after a command
+        door.status = (DoorStatus)saved.door_status;
+        if (door.status == DoorStatus::opening || door.status == DoorStatus::closing) {
+            door.status = door.servo_angle > SERVO_ANGLE_MIN ? DoorStatus::opened : DoorStatus::closed;
+        }
+
+        if (saved.published & DevicePublished::published_status) {
+            at_cache.seed(&door.status_key, saved.published_status);
+        }
+        if (saved.published & DevicePublished::published_re) {
+            at_cache.seed(&door.re_value_key, saved.published_re);
+        }
+        if (saved.published & DevicePublished::published_position) {
+            at_cache.seed(&door.position_key, saved.published_position);
+        }
+    }
+
+    APP_SEQUENCE = state.app_sequence;
+    APP_SEQUENCE_KNOWN = state.app_sequence_known != 0;
+
+    if (state.published & DevicePublished::published_ack) {
+        at_cache.seed(&app_ack_key, state.published_ack);
+    }
+}
+
+void timer_fired(int id, bool overrun)
+{
+    if (overrun) {
+        timer_run(id);
+    } else {
+        events.add(Message(Event::TIMER_DUE, (int16_t)id));
+    }
+}
+
+void timer_is_due(const Message& message)
+{
+    timer_run(message.value);
+}
+
+void timer_run(int id)
+{
+    // The TIMER_DUE of an overrun timer is still on the EventBus after its
+    // work was done
+    if (!timer_wheel.ran(id, millis())) {
+        return;
+    }
+
+    switch (id) {
+    case TimerId::app_e_poll: {
+        // Read the AtSign secondary server to see if an Application event has
+        // occured, the data is checked once the network task has read it in
+        // net_request_completed(). The value is only read if the key was
+        // updated since the last poll. Not needed while the monitor is
+        // pushing the updates.
+        if (!app_monitor.connected()) {
+            net_worker.post_get_changed(&app_events_key, APP_E_VERSION);
+        }
+        break;
+    }
+    case TimerId::telemetry: {
+        stats_publish();
+        break;
+    }
+    }
+}
+
+void log_drain()
+{
+    static const char LEVEL_LETTERS[] = "EWID";
+    LogRecord record;
+
+    while (Serial.availableForWrite() >= LOG_LINE_MAX && log_ring.take(record)) {
+        char line[LOG_LINE_MAX];
+        int length = snprintf(line, sizeof(line), "%lu.%03lu %c ",
+            (unsigned long)(record.at / 1000000), (unsigned long)(record.at / 1000 % 1000), LEVEL_LETTERS[record.level & 3]);
+        if (record.id < LOG_COUNT) {
+            length += snprintf(line + length, sizeof(line) - length - 1, LOG_FORMATS[record.id], (long)record.a, (long)record.b);
+        }
+        if (length > (int)sizeof(line) - 2) {
+            length = sizeof(line) - 2;
+        }
+        line[length++] = '\n';
+        Serial.write((const uint8_t*)line, length);
+    }
+}
+
+void idle_until_due()
+{
+    // An input from here on cuts the wait short, one that came before it was
+    // prepared is on the EventBus already
+    idle_prepare();
+    if (!events.empty()) {
+        return;
+    }
+
+    unsigned long now = millis();
+    unsigned long wait = IDLE_MAX_SLEEP_MS;
+    wait = std::min(wait, timer_wheel.next_due_in(now));
+    for (const Door& door : doors) {
+        wait = std::min(wait, door.motion.next_step_in(now));
+    }
+    wait = std::min(wait, lcd_frame.flush_in(now, LCD_REFRESH_MS));
+    wait = std::min(wait, at_cache.expire_in(now, AT_CACHE_IN_FLIGHT_MS));
+    if (net_worker.connected()) {
+        wait = std::min(wait, at_cache.flush_in(now, AT_CACHE_FLUSH_MS));
+        if (at_cache.settled(&door_cycles_key)) {
+            wait = std::min(wait, cycle_log.upload_in(now, CYCLE_UPLOAD_MS));
+        }
+    }
+    if (!log_ring.empty()) {
+        wait = std::min(wait, (unsigned long)LOG_DRAIN_MS);
+    }
+    if (!doors_moving()) {
+        wait = std::min(wait, device_state.save_in(device_state_capture(), now, DEVICE_STATE_SAVE_MS));
+        wait = std::min(wait, cycle_log.save_in(now, CYCLE_LOG_SAVE_MS));
+    }
+    if (wait < IDLE_MIN_SLEEP_MS) {
+        return;
+    }
+
+    idle_stats.sleep_begin(micros());
+    bool woken = idle_wait(wait);
+    idle_stats.sleep_end(micros(), woken);
+}
+
+size_t event_bus_depth()
+{
+    return events.size();
+}
+
+void network_stop()
+{
+    app_monitor.stop();
+    net_worker.stop();
+}
+
+int32_t re_detents_decoded()
+{
+    return RE_DETENTS;
+}
@@ -0,0 +1,87 @@
+/**
+ * Author: Malav Patel
+ * File: native_main.cpp
+ * Purpose: This file contains the entry point used by the native
+ * (host) environment. It runs the same setup() and loop() as the ESP32
+ * against the fakes from lib/hal, on a virtual clock, so the event
+ * pipeline can be exercised and timed on Linux without a board.
+ *
+ * Usage: program [iterations] [touch_interval_ms] [network_latency_ms] [app_interval_ms]
+ */
+#if !defined(ARDUINO) && !defined(SIM_DETERMINISTIC)
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "constants.h"
+#include "hal.h"
+#include "rolling_token.h"
+
+void setup();
+void loop();
+void stats_dump();
+void network_stop();
+
+int main(int argc, char** argv)
+{
+    unsigned long iterations = argc > 1 ? strtoul(argv[1], nullptr, 10) : 100000;
+    unsigned long touch_interval_ms = argc > 2 ? strtoul(argv[2], nullptr, 10) : 20000;
+    unsigned long network_latency_ms = argc > 3 ? strtoul(argv[3], nullptr, 10) : 0;
+    unsigned long app_interval_ms = argc > 4 ? strtoul(argv[4], nullptr, 10) : 0;
+
+    hal_sim::set_network_latency_millis(network_latency_ms);
+    // The client Application shares the secret of the device
+    const RollingToken app_token(APP_TOKEN_SECRET);
+
+    setup();
+
+    auto start = std::chrono::steady_clock::now();
+    unsigned long last_touch = millis();
+    unsigned long last_app = millis();
+    bool app_opens = true;
+
+    for (unsigned long i = 0; i < iterations; i++) {
+        // Every iteration of loop() is one virtual millisecond apart
+        hal_sim::advance_millis(1);
+
+        // Press the touch sensor at a fixed interval to cycle the door
+        if (touch_interval_ms > 0 && millis() - last_touch >= touch_interval_ms) {
+            hal_sim::drive_pin(TOUCH_SENSOR, HIGH);
+            hal_sim::drive_pin(TOUCH_SENSOR, LOW);
+            last_touch = millis();
+        }
+
+        // Play the client Application: derive the token and ask to open or close
+        if (app_interval_ms > 0 && millis() - last_app >= app_interval_ms) {
+            uint32_t token = app_token.at(RollingToken::window(hal_sim::app_clock_seconds()));
+            hal_sim::server_put("app_e", std::string(app_opens ? "2z" : "4z") + std::to_string(token));
+            app_opens = !app_opens;
+            last_app = millis();
+        }
+
+        loop();
+    }
+
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    double seconds = std::chrono::duration<double>(elapsed).count();
+
+    std::cerr << "iterations:       " << iterations << '\n'
+              << "wall time (s):    " << seconds << '\n'
+              << "iterations / s:   " << (seconds > 0 ? iterations / seconds : 0) << '\n'
+              << "virtual time (ms): " << millis() << '\n'
+              << "blocked in delay: " << hal_sim::delayed_millis() << '\n'
+              << "server puts:      " << hal_sim::server_puts() << '\n'
+              << "server gets:      " << hal_sim::server_gets() << '\n'
+              << "notifications:    " << hal_sim::monitor_notifications() << '\n'
+              << "servo writes:     " << hal_sim::servo_writes() << '\n'
+              << "lcd bus bytes:    " << hal_sim::lcd_bus_bytes() << '\n';
+
+    stats_dump();
+    network_stop();
+
+    return 0;
+}
+
+#endif
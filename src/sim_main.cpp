@@ -0,0 +1,1443 @@
+/**
+ * Author: Malav Patel
+ * File: sim_main.cpp
+ * Purpose: This file contains the entry point used by the sim environment.
+ * It is a deterministic discrete event simulator of the firmware: setup()
+ * and loop() run against the fakes from lib/hal on a virtual clock, the
+ * network worker and the monitor are stepped on the same thread, and the
+ * touch sensor, Rotary Encoder and client Application are played from a
+ * timeline. Hours of door operation run in seconds and two runs of the same
+ * timeline give the same trace.
+ *
+ * Usage: program [--script file] [--random seed] [--hours h] [--latency ms]
+ *                [--settle s] [--persist prefix] [--trace] [--verbose]
+ *        program --bench-bus
+ *        program --bench-halt
+ *        program --bench-parser
+ *        program --bench-token
+ *        program --bench-log
+ *        program --bench-doors
+ *        program --bench-poll
+ *        program --bench-cycles
+ *        program --fuzz-parser [iterations]
+ *
+ * A script has one input per line, "<ms> <command> [argument]", where ms is
+ * the virtual time since setup() the input happens at:
+ *   touch                press the touch sensor
+ *   button               press the Rotary Encoder button
+ *   turn <detents> [us]  turn the Rotary Encoder, negative turns it back,
+ *                        one quadrature transition every us microseconds
+ *   pins <CD,CD,..> [us] replay a captured CLK/DAT trace, for example 01,00,10,
+ *                        with us 0 both pins change before the interrupt runs,
+ *                        as when the encoder turns faster than it can follow
+ *   app <id>[:percent]   the client Application writes an event to app_e
+ *   batch <id[:percent][@door],..>  the client Application writes an AppBatch of
+ *                        up to APP_BATCH_MAX commands to app_e
+ *   replay <n>           someone who read app_e writes back the value the
+ *                        client Application wrote n values before its last
+ *   drop                 the monitor connection is lost
+ *   refuse / accept      the server refuses or accepts monitor connections
+ *   offline <ms>         the network is gone for ms, writes are lost and the
+ *                        device has to connect again
+ *   latency <ms>         change the network latency
+ *   skew <s>             the clock of the device runs s seconds ahead of the
+ *                        client Application, negative for behind
+ *   flood <ms>           press the touch sensor on every millisecond for ms,
+ *                        so the EventBus is never empty
+ *   stats                send STATS_DUMP_KEY over serial
+ *   expect <key> <value> the server has value for key, a violation if not;
+ *                        the key detents is the net detents the firmware
+ *                        decoded from the Rotary Encoder since boot
+ * Lines starting with # are ignored. Without a script a random timeline is
+ * generated from the seed, so a failing run can be repeated with its seed.
+ *
+ * The run ends with --settle seconds without input, after which the values
+ * published on the server have to agree with the servo. The exit status is 1
+ * if they do not or if the servo was ever driven out of its range.
+ *
+ * With --persist the flash of the device and the secondary server are read
+ * from prefix.flash and prefix.server before setup() and written back at the
+ * end, so the next run with the same prefix boots like the device after a
+ * reboot.
+ *
+ * --bench-bus measures adding and taking events on the EventBus against the
+ * std::deque it replaced, on one thread and from a producer thread to the
+ * loop, and prints the p50/p99/max of every case. --bench-halt measures what
+ * a halt costs the EventBus against the number of motion events waiting
+ * behind it, and exits. --bench-parser measures the
+ * decoding of an AppBatch and --fuzz-parser decodes random and mutated
+ * batches, checking that decode() stays in its bounds and that every batch
+ * that is encoded decodes to the same commands. --bench-token measures how
+ * long the device takes to check the token of a command. --bench-log
+ * measures adding a record to a LogRing against formatting it, the work that
+ * is deferred until the loop is idle. --bench-doors times loop() while 1 to
+ * DOOR_COUNT doors move at the same time, build with -D DOOR_COUNT to try
+ * more doors. --bench-poll measures a poll of app_e that finds the value it
+ * read before: reading and checking it, reading it and comparing its hash,
+ * and only looking up its version. --bench-cycles measures adding a door
+ * cycle to a CycleLog and encoding an upload, and the bytes a record takes.
+ *
+ * The firmware waits in idle_wait() while it has nothing to do, the inputs and
+ * tasks go on from there a millisecond at a time, so whole seconds pass in one
+ * iteration of loop(). The report prints the idle time the fake measured,
+ * which the idle time in the statistics of the firmware has to match.
+ */
+#if !defined(ARDUINO) && defined(SIM_DETERMINISTIC)
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "app_command.h"
+#include "constants.h"
+#include "cycle_log.h"
+#include "event_bus.h"
+#include "hal.h"
+#include "latency_stats.h"
+#include "log_ring.h"
+#include "net_worker.h"
+#include "rolling_token.h"
+
+void setup();
+void loop();
+void stats_dump();
+void network_stop();
+size_t event_bus_depth();
+int32_t re_detents_decoded();
+bool doors_moving();
+bool app_event_received(const char* data);
+uint32_t app_value_hash(const char* data);
+
+// Inputs that get no response within this long are counted as unanswered
+#define SIM_RESPONSE_TIMEOUT_MS 60000
+
+/**
+ * One input of the timeline.
+ */
+struct SimInput {
+    unsigned long at;
+    std::string command;
+    std::string argument;
+    std::string speed;
+};
+
+/**
+ * The CLK/DAT levels of the Rotary Encoder turning forward, one quadrature
+ * transition after the other.
+ */
+static const int RE_SEQUENCE[4] = { 0x3, 0x1, 0x0, 0x2 };
+
+/**
+ * The servo pin of every door, like the firmware has them.
+ */
+static const int DOOR_SERVOS[] = DOOR_SERVO_PINS;
+
+/**
+ * Description: Name an AtKey of a door the way the firmware does, door 0 has
+ * the plain name and the others add their number.
+ * Pre: None
+ * Post: Returns the name of the key on the server.
+ */
+static std::string door_key(const char* name, int door)
+{
+    return door == 0 ? std::string(name) : std::string(name) + "_" + std::to_string(door + 1);
+}
+
+/**
+ * Description: Join a value of every door, separated by commas.
+ * Pre: None
+ * Post: Returns the values of door 0 to DOOR_COUNT - 1.
+ */
+template <typename F>
+static std::string every_door(F value)
+{
+    std::string values;
+    for (int door = 0; door < DOOR_COUNT; door++) {
+        values += (door == 0 ? "" : ",") + value(door);
+    }
+    return values;
+}
+
+/**
+ * Description: The door_status of every door on the server.
+ * Pre: None
+ * Post: Returns the values joined by every_door().
+ */
+static std::string door_statuses()
+{
+    return every_door([](int door) { return hal_sim::server_get(door_key("door_status", door)); });
+}
+
+static bool trace = false;
+static unsigned long violations = 0;
+
+// The input whose response is being timed
+static bool awaiting_servo = false;
+static bool awaiting_status = false;
+static unsigned long awaited_since = 0;
+static unsigned long awaited_servo_writes = 0;
+static std::string awaited_status;
+
+static LatencyHistogram servo_response;
+static LatencyHistogram status_response;
+static LatencyHistogram bus_depth;
+static unsigned long superseded = 0;
+static unsigned long unanswered = 0;
+static unsigned long inputs = 0;
+
+// The touch sensor is pressed on every tick until then
+static unsigned long flood_until = 0;
+
+// The inputs sorted by time, the next one to apply and when setup() ended
+static std::vector<SimInput> timeline;
+static size_t next_input = 0;
+static unsigned long booted_at = 0;
+
+// Iterations of loop()
+static unsigned long loops = 0;
+
+/**
+ * Description: Drive the Rotary Encoder pins to a CLK/DAT state, one pin at a
+ * time like the hardware, each change some microseconds after the last. With
+ * us 0 a change of both pins reaches the interrupt handler as one.
+ * Pre: None
+ * Post: The attached interrupt handler ran for every pin that changed, or
+ * once if both changed at once.
+ */
+static void drive_encoder(int state, unsigned long us)
+{
+    int clk = (state >> 1) & 1;
+    int dat = state & 1;
+    if (us == 0 && digitalRead(RE_CLK) != clk && digitalRead(RE_DAT) != dat) {
+        // The interrupt of CLK comes too late and sees both pins changed
+        hal_sim::set_pin(RE_CLK, clk);
+        hal_sim::drive_pin(RE_DAT, dat);
+        return;
+    }
+    if (digitalRead(RE_CLK) != clk) {
+        hal_sim::drive_pin(RE_CLK, clk);
+        hal_sim::advance_micros(us);
+    }
+    if (digitalRead(RE_DAT) != dat) {
+        hal_sim::drive_pin(RE_DAT, dat);
+        hal_sim::advance_micros(us);
+    }
+}
+
+static void turn_encoder(long detents, unsigned long us)
+{
+    int state = (digitalRead(RE_CLK) << 1) | digitalRead(RE_DAT);
+    int position = 0;
+    while (RE_SEQUENCE[position] != state) {
+        position++;
+    }
+
+    long steps = (detents < 0 ? -detents : detents) * RE_STEPS_PER_DETENT;
+    int direction = detents < 0 ? 3 : 1;
+    for (long i = 0; i < steps; i++) {
+        position = (position + direction) & 3;
+        drive_encoder(RE_SEQUENCE[position], us);
+    }
+}
+
+static void replay_pins(const std::string& states, unsigned long us)
+{
+    std::stringstream stream(states);
+    std::string state;
+    while (std::getline(stream, state, ',')) {
+        if (state.size() == 2) {
+            drive_encoder(((state[0] == '1') << 1) | (state[1] == '1'), us);
+        }
+    }
+}
+
+/**
+ * Description: Start timing how long the firmware takes to move the servo and
+ * to publish a new door status after an input.
+ * Pre: None
+ * Post: An input that was still being timed is counted as superseded.
+ */
+static void await_response()
+{
+    if (awaiting_servo || awaiting_status) {
+        superseded++;
+    }
+    awaiting_servo = true;
+    awaiting_status = true;
+    awaited_since = millis();
+    awaited_servo_writes = hal_sim::servo_writes();
+    awaited_status = door_statuses();
+}
+
+static void check_response()
+{
+    if (!awaiting_servo && !awaiting_status) {
+        return;
+    }
+    unsigned long waited = millis() - awaited_since;
+    if (awaiting_servo && hal_sim::servo_writes() != awaited_servo_writes) {
+        servo_response.record((uint32_t)waited);
+        awaiting_servo = false;
+    }
+    if (awaiting_status && door_statuses() != awaited_status) {
+        status_response.record((uint32_t)waited);
+        awaiting_status = false;
+    }
+    if ((awaiting_servo || awaiting_status) && waited >= SIM_RESPONSE_TIMEOUT_MS) {
+        unanswered++;
+        awaiting_servo = false;
+        awaiting_status = false;
+    }
+}
+
+/**
+ * Sequence number of the last command the client Application sent in a batch
+ */
+static uint16_t app_sequence = 0;
+
+/**
+ * The client Application derives its tokens from the same secret as the device
+ */
+static const RollingToken app_token(APP_TOKEN_SECRET);
+
+static uint32_t app_current_token()
+{
+    return app_token.at(RollingToken::window(hal_sim::app_clock_seconds()));
+}
+
+/**
+ * Every value the client Application wrote to app_e, for replay
+ */
+static std::vector<std::string> app_written;
+
+static void app_write(const std::string& value)
+{
+    app_written.push_back(value);
+    hal_sim::server_put("app_e", value);
+}
+
+/**
+ * Description: Build a batch from "<id>[:percent][@door],..", numbering the commands
+ * after the ones sent before.
+ * Pre: None
+ * Post: Returns false if there are no commands or more than APP_BATCH_MAX.
+ */
+static bool parse_batch(const std::string& argument, AppBatch& batch)
+{
+    std::stringstream stream(argument);
+    std::string command;
+    batch.count = 0;
+    // Carry on after the last command the device applied before a reboot
+    if (app_sequence == 0) {
+        app_sequence = (uint16_t)strtoul(hal_sim::server_get("app_ack").c_str(), nullptr, 10);
+    }
+    while (std::getline(stream, command, ',')) {
+        if (batch.count == APP_BATCH_MAX) {
+            return false;
+        }
+        AppCommand& next = batch.commands[batch.count++];
+        char* end = nullptr;
+        next.sequence = ++app_sequence;
+        next.event = (uint8_t)strtoul(command.c_str(), &end, 10);
+        next.value = *end == ':' ? (int16_t)strtol(end + 1, &end, 10) : 0;
+        next.door = *end == '@' ? (uint8_t)strtoul(end + 1, nullptr, 10) : 0;
+    }
+    return batch.count > 0;
+}
+
+/**
+ * Description: Check a value on the server, or the detents decoded, that a
+ * script expects.
+ * Pre: None
+ * Post: A different value is printed and counted as a violation.
+ */
+static void expect(const std::string& key, const std::string& expected)
+{
+    std::string value = key == "detents" ? std::to_string(re_detents_decoded()) : hal_sim::server_get(key);
+    if (value != expected) {
+        std::cerr << millis() << " expected " << key << ' ' << expected << ", server has " << value << '\n';
+        violations++;
+    }
+}
+
+static void apply(const SimInput& input)
+{
+    if (input.command == "expect") {
+        // The value is the third field, where other inputs have their speed
+        expect(input.argument, input.speed);
+        return;
+    }
+
+    unsigned long us = input.speed.empty() ? 500 : strtoul(input.speed.c_str(), nullptr, 10);
+    inputs++;
+
+    if (trace) {
+        std::cerr << millis() << " input " << input.command << ' ' << input.argument
+                  << " depth " << event_bus_depth() << '\n';
+    }
+
+    if (input.command == "touch") {
+        await_response();
+        hal_sim::drive_pin(TOUCH_SENSOR, HIGH);
+        hal_sim::drive_pin(TOUCH_SENSOR, LOW);
+    } else if (input.command == "button") {
+        hal_sim::drive_pin(RE_BUTTON, HIGH);
+        hal_sim::drive_pin(RE_BUTTON, LOW);
+    } else if (input.command == "turn") {
+        await_response();
+        turn_encoder(strtol(input.argument.c_str(), nullptr, 10), us);
+    } else if (input.command == "pins") {
+        replay_pins(input.argument, us);
+    } else if (input.command == "app") {
+        await_response();
+        app_write(input.argument + "z" + std::to_string(app_current_token()));
+    } else if (input.command == "batch") {
+        AppBatch batch;
+        if (parse_batch(input.argument, batch)) {
+            char text[128];
+            batch.token = app_current_token();
+            AppBatch::encode(batch, text, sizeof(text));
+            await_response();
+            app_write(text);
+        }
+    } else if (input.command == "replay") {
+        size_t back = strtoul(input.argument.c_str(), nullptr, 10);
+        if (back < app_written.size()) {
+            hal_sim::server_put("app_e", app_written[app_written.size() - 1 - back]);
+        }
+    } else if (input.command == "drop") {
+        hal_sim::monitor_drop();
+    } else if (input.command == "offline") {
+        hal_sim::network_offline(strtoul(input.argument.c_str(), nullptr, 10));
+    } else if (input.command == "refuse") {
+        hal_sim::monitor_refuse(true);
+    } else if (input.command == "accept") {
+        hal_sim::monitor_refuse(false);
+    } else if (input.command == "latency") {
+        hal_sim::set_network_latency_millis(strtoul(input.argument.c_str(), nullptr, 10));
+    } else if (input.command == "skew") {
+        hal_sim::set_wall_clock_skew(strtol(input.argument.c_str(), nullptr, 10));
+    } else if (input.command == "flood") {
+        flood_until = millis() + strtoul(input.argument.c_str(), nullptr, 10);
+    } else if (input.command == "stats") {
+        hal_sim::serial_input("s");
+    } else {
+        std::cerr << "unknown input: " << input.command << '\n';
+    }
+}
+
+static bool read_script(const char* path, std::vector<SimInput>& timeline)
+{
+    std::ifstream file(path);
+    if (!file) {
+        return false;
+    }
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        std::stringstream stream(line);
+        SimInput input;
+        if (stream >> input.at >> input.command) {
+            stream >> input.argument >> input.speed;
+            timeline.push_back(input);
+        }
+    }
+    return true;
+}
+
+/**
+ * Description: Generate a random timeline: inputs about every 15 seconds,
+ * touches, app commands, batches for a random door, scrubbing with the
+ * Rotary Encoder at random speeds, bouncy encoder traces (which select
+ * another door while the encoder is set), lost monitor connections, network
+ * outages and changing latency.
+ * Pre: None
+ * Post: timeline holds the inputs up to duration_ms, the same for a seed.
+ */
+static void random_script(unsigned long seed, unsigned long duration_ms, std::vector<SimInput>& timeline)
+{
+    std::mt19937 random(seed);
+    std::exponential_distribution<double> gap(1.0 / 15000);
+    std::uniform_int_distribution<int> percent(0, 99);
+
+    unsigned long at = 0;
+    for (;;) {
+        at += 1 + (unsigned long)gap(random);
+        if (at >= duration_ms) {
+            return;
+        }
+
+        int kind = percent(random);
+        if (kind < 30) {
+            timeline.push_back({ at, "touch", "", "" });
+        } else if (kind < 55) {
+            static const char* const commands[] = { "2", "4", "6", "19" };
+            std::string command = commands[percent(random) % 4];
+            if (command == "19") {
+                command += ":" + std::to_string(percent(random) + 1);
+            }
+            timeline.push_back({ at, "app", command, "" });
+        } else if (kind < 60) {
+            // A halt followed by a move, or a few moves in a row, of one door
+            std::string commands = percent(random) < 50 ? "6" : "";
+            int moves = 1 + percent(random) % 3;
+            for (int i = 0; i < moves; i++) {
+                commands += std::string(commands.empty() ? "" : ",") + "19:" + std::to_string(percent(random) + 1);
+            }
+            if (DOOR_COUNT > 1) {
+                std::string door = "@" + std::to_string(percent(random) % DOOR_COUNT);
+                for (size_t i = commands.find(','); i != std::string::npos; i = commands.find(',', i + door.size() + 1)) {
+                    commands.insert(i, door);
+                }
+                commands += door;
+            }
+            timeline.push_back({ at, "batch", commands, "" });
+        } else if (kind < 80) {
+            long detents = percent(random) % 6 + 1;
+            if (percent(random) < 50) {
+                detents = -detents;
+            }
+            timeline.push_back({ at, "button", "", "" });
+            timeline.push_back({ at + 100, "turn", std::to_string(detents), std::to_string(50 + percent(random) * 20) });
+            timeline.push_back({ at + 2000, "button", "", "" });
+        } else if (kind < 90) {
+            std::string states;
+            int length = 3 + percent(random) % 10;
+            for (int i = 0; i < length; i++) {
+                int state = percent(random) & 3;
+                states += std::string(i == 0 ? "" : ",") + (char)('0' + (state >> 1)) + (char)('0' + (state & 1));
+            }
+            timeline.push_back({ at, "pins", states, "20" });
+        } else if (kind < 93) {
+            timeline.push_back({ at, "drop", "", "" });
+        } else if (kind < 95) {
+            timeline.push_back({ at, "offline", std::to_string(1000 + percent(random) * 200), "" });
+        } else if (kind < 98) {
+            timeline.push_back({ at, "latency", std::to_string(percent(random) * 20), "" });
+        } else {
+            // Mostly within the skew tolerated, sometimes far enough to be refused
+            timeline.push_back({ at, "skew", std::to_string(percent(random) - 50), "" });
+        }
+    }
+}
+
+/**
+ * Description: Check the responses to the inputs, the servo range and, with
+ * --trace, print the changes of the door status.
+ * Pre: None
+ * Post: Every violation is printed and counted.
+ */
+static void check()
+{
+    check_response();
+
+    for (int door = 0; door < DOOR_COUNT; door++) {
+        int angle = hal_sim::servo_angle(DOOR_SERVOS[door]);
+        if (angle < SERVO_ANGLE_MIN || angle > SERVO_ANGLE_MAX) {
+            std::cerr << millis() << " servo " << door + 1 << " out of range: " << angle << '\n';
+            violations++;
+        }
+    }
+
+    if (trace) {
+        static std::string status = door_statuses();
+        std::string now = door_statuses();
+        if (now != status) {
+            std::cerr << millis() << " door_status " << now << " servo "
+                      << every_door([](int door) { return std::to_string(hal_sim::servo_angle(DOOR_SERVOS[door])); }) << '\n';
+            status = now;
+        }
+    }
+}
+
+/**
+ * Description: Advance the virtual clock by one millisecond, apply the
+ * inputs that are due and run the background tasks. This is also what happens
+ * for every millisecond the firmware waits in idle_wait().
+ * Pre: setup() has run.
+ * Post: Responses and the servo range have been checked.
+ */
+static void step()
+{
+    hal_sim::advance_millis(1);
+    while (next_input < timeline.size() && millis() - booted_at >= timeline[next_input].at) {
+        apply(timeline[next_input++]);
+    }
+    hal_sim::run_tasks();
+    if (millis() < flood_until) {
+        hal_sim::drive_pin(TOUCH_SENSOR, HIGH);
+        hal_sim::drive_pin(TOUCH_SENSOR, LOW);
+    }
+    check();
+}
+
+/**
+ * Description: Run what the device would in one millisecond: the background
+ * tasks and one iteration of loop(), which may wait through more of them.
+ * Pre: setup() has run.
+ * Post: Responses, queue depth and the servo range have been checked.
+ */
+static void tick()
+{
+    step();
+    loop();
+    loops++;
+
+    bus_depth.record((uint32_t)event_bus_depth());
+    check();
+}
+
+/**
+ * Description: Check the values published on the server agree with the servo
+ * of every door once the doors have settled.
+ * Pre: No input for long enough that every request has completed.
+ * Post: Every disagreement is printed and counted.
+ */
+static void check_settled()
+{
+    // The last upload of the door cycles has to decode to doors the device has
+    std::string uploaded = hal_sim::server_get("door_cycles");
+    uint32_t first = 0;
+    DoorCycle cycles[16];
+    size_t count = CycleLog::decode(uploaded.c_str(), first, cycles, 16);
+    if (!uploaded.empty() && count == 0) {
+        std::cerr << "settled door_cycles " << uploaded << " does not decode\n";
+        violations++;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (cycles[i].door >= DOOR_COUNT || cycles[i].end > DoorCycleEnd::cycle_superseded) {
+            std::cerr << "settled door_cycles record " << first + i << " of door " << (int)cycles[i].door
+                      << " ending " << (int)cycles[i].end << '\n';
+            violations++;
+        }
+    }
+
+    for (int door = 0; door < DOOR_COUNT; door++) {
+        int angle = hal_sim::servo_angle(DOOR_SERVOS[door]);
+        std::string status_key = door_key("door_status", door);
+        std::string position_key = door_key("door_position", door);
+        std::string status = hal_sim::server_get(status_key);
+        std::string position = hal_sim::server_get(position_key);
+        int expected = (angle - SERVO_ANGLE_MIN) * 100 / (SERVO_ANGLE_MAX - SERVO_ANGLE_MIN);
+
+        bool ok = (status == "1" && angle == SERVO_ANGLE_MIN) || (status == "0" && angle > SERVO_ANGLE_MIN);
+        if (!ok) {
+            std::cerr << "settled " << status_key << ' ' << status << " with servo at " << angle << '\n';
+            violations++;
+        }
+        if (position != std::to_string(expected)) {
+            std::cerr << "settled " << position_key << ' ' << position << " with servo at " << angle << '\n';
+            violations++;
+        }
+    }
+}
+
+/**
+ * An event of --bench-bus, stamped by the producer so the consumer can tell
+ * how long it waited. All of them are one kind.
+ */
+struct BenchEvent {
+    uint32_t number;
+    std::chrono::steady_clock::time_point at;
+};
+
+inline size_t event_kind(const BenchEvent& e)
+{
+    (void)e;
+    return 0;
+}
+
+/**
+ * The EventBus as it was before the rings: a std::deque, add() at the back
+ * and sos() at the front. It allocates as it grows and is not safe to use
+ * from more than one thread, the producer thread case guards it with a mutex.
+ */
+template <typename T>
+struct DequeBus {
+    std::deque<T> events;
+    std::mutex lock;
+
+    bool empty() { return events.empty(); }
+    T current() { return events.front(); }
+    void add(T e) { events.push_back(e); }
+    void sos(T e) { events.push_front(e); }
+    void current_completed() { events.pop_front(); }
+};
+
+/**
+ * One EventRing on its own, without the levels, cancels and folding the
+ * EventBus adds on top. sos() goes to the back like add().
+ */
+template <typename T>
+struct RingOnly {
+    EventRing<T, 64> events;
+
+    bool empty() { return events.peek() == nullptr; }
+    T current() { return *events.peek(); }
+    bool add(T e) { return events.push(e); }
+    bool sos(T e) { return events.push(e); }
+    void current_completed() { events.pop(); }
+};
+
+/**
+ * Description: Print the p50, p99 and max of the samples.
+ * Pre: samples is not empty.
+ * Post: samples is sorted.
+ */
+static void print_percentiles(const char* name, std::vector<long>& samples)
+{
+    std::sort(samples.begin(), samples.end());
+    size_t count = samples.size();
+    std::cout << name << "  " << samples[count / 2] << '/' << samples[count * 99 / 100] << '/'
+              << samples[count - 1] << '\n';
+}
+
+/**
+ * Description: Time adding a burst of events to a bus and taking them again
+ * on one thread, per event. Every fourth event is added with sos().
+ * Pre: The bus is empty.
+ * Post: One sample per burst is appended to add_ns and take_ns.
+ */
+template <typename Bus>
+static void bus_bursts(Bus& bus, int repeats, std::vector<long>& add_ns, std::vector<long>& take_ns)
+{
+    const int BURST = 32;
+    unsigned long taken = 0;
+    for (int i = 0; i < repeats; i++) {
+        auto start = std::chrono::steady_clock::now();
+        for (int j = 0; j < BURST; j++) {
+            BenchEvent e = { (uint32_t)j, start };
+            if (j % 4 == 3) {
+                bus.sos(e);
+            } else {
+                bus.add(e);
+            }
+        }
+        auto middle = std::chrono::steady_clock::now();
+        while (!bus.empty()) {
+            taken += bus.current().number;
+            bus.current_completed();
+        }
+        auto end = std::chrono::steady_clock::now();
+        add_ns.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(middle - start).count() / BURST);
+        take_ns.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(end - middle).count() / BURST);
+    }
+    if (taken != (unsigned long)repeats * BURST * (BURST - 1) / 2) {
+        std::cerr << "events were lost\n";
+    }
+}
+
+/**
+ * Description: Measure how long an event waits from a producer thread adding
+ * it until the consumer takes it, the path from an interrupt handler to
+ * loop(). The producer adds an event, retries while the bus is full and
+ * yields, the consumer yields while the bus is empty, so the wait includes
+ * switching threads when the host has a single core.
+ * Pre: None
+ * Post: One sample per event is appended to wait_ns.
+ */
+template <typename Add, typename Take>
+static void bus_handoff(int count, Add add, Take take, std::vector<long>& wait_ns)
+{
+    std::thread producer([&]() {
+        for (int i = 0; i < count; i++) {
+            auto at = std::chrono::steady_clock::now();
+            while (!add(BenchEvent { (uint32_t)i, at })) {
+                std::this_thread::yield();
+            }
+            std::this_thread::yield();
+        }
+    });
+    BenchEvent e;
+    for (int received = 0; received < count;) {
+        if (take(e)) {
+            auto waited = std::chrono::steady_clock::now() - e.at;
+            wait_ns.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(waited).count());
+            received++;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+}
+
+/**
+ * Description: Compare the EventBus with the std::deque it replaced: the
+ * cost of adding and of taking an event on one thread, also for a bare
+ * EventRing, and the wait of an event added on another thread until the
+ * consumer takes it.
+ * Pre: None
+ * Post: The p50/p99/max of every case is printed in nanoseconds.
+ */
+static void bus_bench()
+{
+    const int REPEATS = 20000;
+    const int HANDOFFS = 200000;
+    static EventBus<BenchEvent, 64, 8, 1, 4, 1> ring;
+    static RingOnly<BenchEvent> ring_only;
+    static DequeBus<BenchEvent> deque;
+
+    std::vector<long> add_ns;
+    std::vector<long> take_ns;
+    std::cout << "bus  p50/p99/max ns\n";
+
+    bus_bursts(ring, REPEATS, add_ns, take_ns);
+    print_percentiles("ring add", add_ns);
+    print_percentiles("ring take", take_ns);
+    add_ns.clear();
+    take_ns.clear();
+    bus_bursts(ring_only, REPEATS, add_ns, take_ns);
+    print_percentiles("ring only add", add_ns);
+    print_percentiles("ring only take", take_ns);
+    add_ns.clear();
+    take_ns.clear();
+    bus_bursts(deque, REPEATS, add_ns, take_ns);
+    print_percentiles("deque add", add_ns);
+    print_percentiles("deque take", take_ns);
+
+    std::vector<long> wait_ns;
+    bus_handoff(
+        HANDOFFS, [&](const BenchEvent& e) { return ring.add(e); },
+        [&](BenchEvent& e) {
+            if (ring.empty()) {
+                return false;
+            }
+            e = ring.current();
+            ring.current_completed();
+            return true;
+        },
+        wait_ns);
+    print_percentiles("ring wait", wait_ns);
+
+    wait_ns.clear();
+    bus_handoff(
+        HANDOFFS,
+        [&](const BenchEvent& e) {
+            std::lock_guard<std::mutex> guard(deque.lock);
+            deque.add(e);
+            return true;
+        },
+        [&](BenchEvent& e) {
+            std::lock_guard<std::mutex> guard(deque.lock);
+            if (deque.empty()) {
+                return false;
+            }
+            e = deque.current();
+            deque.current_completed();
+            return true;
+        },
+        wait_ns);
+    print_percentiles("deque wait", wait_ns);
+    std::cout << "ring overflows: " << ring.overflow_count() << '\n';
+}
+
+/**
+ * Description: Measure a halt against a growing number of motion events
+ * waiting on an EventBus like the one of the firmware: the cancel of the
+ * motion level the halt handler does, and the work the main loop does later
+ * to skip the cancelled events. Every case is repeated and the median is
+ * printed in nanoseconds.
+ * Pre: None
+ * Post: The table is printed.
+ */
+static void halt_bench()
+{
+    const int MOTION_KIND = 1;
+    const int MOTION_LEVEL = 1;
+    const int REPEATS = 20001;
+    static EventBus<int, 64, 8, 32, 4, 16> bus;
+    bus.set_priority(MOTION_KIND, MOTION_LEVEL);
+
+    std::vector<long> cancel_ns(REPEATS);
+    std::vector<long> skip_ns(REPEATS);
+
+    std::cout << "depth  cancel ns  skip ns\n";
+    for (int depth = 0; depth <= 64; depth = depth == 0 ? 1 : depth * 2) {
+        for (int i = 0; i < REPEATS; i++) {
+            for (int j = 0; j < depth; j++) {
+                bus.add(MOTION_KIND);
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            bus.cancel_level(MOTION_LEVEL);
+            auto cancelled = std::chrono::steady_clock::now();
+            bool empty = bus.empty();
+            auto skipped = std::chrono::steady_clock::now();
+
+            if (!empty) {
+                std::cerr << "cancelled events were not skipped\n";
+            }
+            cancel_ns[i] = std::chrono::duration_cast<std::chrono::nanoseconds>(cancelled - start).count();
+            skip_ns[i] = std::chrono::duration_cast<std::chrono::nanoseconds>(skipped - cancelled).count();
+        }
+        std::nth_element(cancel_ns.begin(), cancel_ns.begin() + REPEATS / 2, cancel_ns.end());
+        std::nth_element(skip_ns.begin(), skip_ns.begin() + REPEATS / 2, skip_ns.end());
+        std::cout << depth << "  " << cancel_ns[REPEATS / 2] << "  " << skip_ns[REPEATS / 2] << '\n';
+    }
+    std::cout << "overflows: " << bus.overflow_count() << " cancelled: " << bus.cancelled_count() << '\n';
+}
+
+/**
+ * Description: Measure how long AppBatch::decode() takes for a full batch.
+ * Pre: None
+ * Post: The median of the runs is printed in nanoseconds.
+ */
+static void parser_bench()
+{
+    const int REPEATS = 20001;
+    const int DECODES = 100;
+    AppBatch batch;
+    batch.token = 42;
+    batch.count = APP_BATCH_MAX;
+    for (int i = 0; i < APP_BATCH_MAX; i++) {
+        batch.commands[i] = { (uint16_t)(1000 + i), 19, (int16_t)(i * 10), 0 };
+    }
+    char text[128];
+    size_t length = AppBatch::encode(batch, text, sizeof(text));
+
+    std::vector<long> decode_ns(REPEATS);
+    unsigned long decoded = 0;
+    for (int i = 0; i < REPEATS; i++) {
+        auto start = std::chrono::steady_clock::now();
+        for (int j = 0; j < DECODES; j++) {
+            AppBatch out;
+            decoded += AppBatch::decode(text, out) ? out.count : 0;
+        }
+        auto end = std::chrono::steady_clock::now();
+        decode_ns[i] = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / DECODES;
+    }
+    std::nth_element(decode_ns.begin(), decode_ns.begin() + REPEATS / 2, decode_ns.end());
+    std::cout << "batch of " << APP_BATCH_MAX << " commands, " << length << " characters\n"
+              << "decode ns: " << decode_ns[REPEATS / 2] << '\n'
+              << "commands decoded: " << decoded << '\n';
+}
+
+/**
+ * Description: Decode random text and mutations of encoded batches, and
+ * round trip random batches through encode() and decode(). A batch of
+ * version 1 has to be refused.
+ * Pre: None
+ * Post: Returns the number of failed checks, which are printed.
+ */
+static int parser_fuzz(unsigned long iterations)
+{
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/=!z: ";
+    std::mt19937 random(1);
+    int failures = 0;
+    unsigned long accepted = 0;
+
+    // Version 1, token 0x1234, one command 2 with sequence 1
+    AppBatch v1;
+    if (AppBatch::decode("!ATQSAQUBAAIAAA==", v1)) {
+        std::cerr << "version 1 batch decoded\n";
+        failures++;
+    }
+
+    for (unsigned long i = 0; i < iterations; i++) {
+        AppBatch batch;
+        batch.token = (uint32_t)random();
+        batch.count = (uint8_t)(random() % (APP_BATCH_MAX + 1));
+        for (int j = 0; j < batch.count; j++) {
+            batch.commands[j] = { (uint16_t)random(), (uint8_t)(random() % APP_BATCH_EVENTS), (int16_t)random(),
+                (uint8_t)(random() % APP_BATCH_DOORS) };
+        }
+        char text[128];
+        size_t length = AppBatch::encode(batch, text, sizeof(text));
+
+        AppBatch out;
+        bool same = length > 0 && AppBatch::decode(text, out) && out.token == batch.token
+            && out.count == batch.count;
+        for (int j = 0; same && j < batch.count; j++) {
+            same = out.commands[j].sequence == batch.commands[j].sequence
+                && out.commands[j].event == batch.commands[j].event
+                && out.commands[j].door == batch.commands[j].door
+                && out.commands[j].value == batch.commands[j].value;
+        }
+        if (!same) {
+            std::cerr << "round trip failed: " << text << '\n';
+            failures++;
+        }
+
+        // Flip, drop or append characters of the encoded batch, or make up text
+        if (random() % 4 == 0) {
+            length = random() % (sizeof(text) - 1);
+            for (size_t j = 0; j < length; j++) {
+                text[j] = (char)(random() % 255 + 1);
+            }
+            text[length] = '\0';
+        } else {
+            int mutations = 1 + random() % 4;
+            for (int j = 0; j < mutations && length > 0; j++) {
+                size_t at = random() % length;
+                switch (random() % 3) {
+                case 0:
+                    text[at] = alphabet[random() % (sizeof(alphabet) - 1)];
+                    break;
+                case 1:
+                    length = at;
+                    text[length] = '\0';
+                    break;
+                default:
+                    if (length + 1 < sizeof(text)) {
+                        text[length++] = alphabet[random() % (sizeof(alphabet) - 1)];
+                        text[length] = '\0';
+                    }
+                }
+            }
+        }
+        if (AppBatch::decode(text, out)) {
+            accepted++;
+            if (out.count > APP_BATCH_MAX) {
+                std::cerr << "decoded " << (int)out.count << " commands: " << text << '\n';
+                failures++;
+            }
+        }
+    }
+    std::cout << "iterations: " << iterations << " mutations accepted: " << accepted
+              << " failures: " << failures << '\n';
+    return failures;
+}
+
+/**
+ * Description: Measure how long checking the token of a command takes, for
+ * a token of the current window, of a window next to it and a wrong one.
+ * Pre: None
+ * Post: The medians of the runs are printed in nanoseconds.
+ */
+static void token_bench()
+{
+    const int REPEATS = 20001;
+    const int CHECKS = 100;
+    const uint32_t NOW = RollingToken::window(1700000000) * ROLLING_TOKEN_WINDOW_S;
+    const uint32_t window = RollingToken::window(NOW);
+    const uint32_t tokens[] = { app_token.at(window), app_token.at(window - 1), app_token.at(window) ^ 1 };
+    const char* const names[] = { "current", "previous", "wrong" };
+
+    std::vector<long> verify_ns(REPEATS);
+    std::cout << "token     verify ns\n";
+    for (int t = 0; t < 3; t++) {
+        unsigned long valid = 0;
+        for (int i = 0; i < REPEATS; i++) {
+            auto start = std::chrono::steady_clock::now();
+            for (int j = 0; j < CHECKS; j++) {
+                valid += app_token.verify(tokens[t], NOW + (uint32_t)j % ROLLING_TOKEN_WINDOW_S);
+            }
+            auto end = std::chrono::steady_clock::now();
+            verify_ns[i] = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / CHECKS;
+        }
+        std::nth_element(verify_ns.begin(), verify_ns.begin() + REPEATS / 2, verify_ns.end());
+        std::cout << names[t] << "  " << verify_ns[REPEATS / 2] << "  (" << valid << " valid)\n";
+    }
+}
+
+/**
+ * Description: Measure what a log record costs the handler that adds it,
+ * against formatting it as a line, and the time the line takes to send at
+ * 115200 baud, which a blocking print would wait for.
+ * Pre: None
+ * Post: The medians of the runs are printed in nanoseconds.
+ */
+static void log_bench()
+{
+    const int REPEATS = 20001;
+    const int RECORDS = LOG_RING_SIZE;
+
+    static LogRing ring;
+    ring.set_clock(micros);
+
+    std::vector<long> add_ns(REPEATS);
+    std::vector<long> format_ns(REPEATS);
+    unsigned long long bytes = 0;
+    LogRecord record;
+    char line[64];
+
+    for (int i = 0; i < REPEATS; i++) {
+        auto start = std::chrono::steady_clock::now();
+        for (int j = 0; j < RECORDS; j++) {
+            LOG_RECORD(ring, LOG_LEVEL_INFO, 5, j, i);
+        }
+        auto middle = std::chrono::steady_clock::now();
+        while (ring.take(record)) {
+            bytes += snprintf(line, sizeof(line), "%lu.%03lu I DOOR %ld IS MOVING TO %ld%%\n",
+                (unsigned long)(record.at / 1000000), (unsigned long)(record.at / 1000 % 1000), (long)record.a, (long)record.b);
+        }
+        auto end = std::chrono::steady_clock::now();
+        add_ns[i] = std::chrono::duration_cast<std::chrono::nanoseconds>(middle - start).count() / RECORDS;
+        format_ns[i] = std::chrono::duration_cast<std::chrono::nanoseconds>(end - middle).count() / RECORDS;
+    }
+
+    std::nth_element(add_ns.begin(), add_ns.begin() + REPEATS / 2, add_ns.end());
+    std::nth_element(format_ns.begin(), format_ns.begin() + REPEATS / 2, format_ns.end());
+    unsigned long long line_bytes = bytes / ((unsigned long long)REPEATS * RECORDS);
+    std::cout << "add ns  format ns  line bytes  send at 115200 ns\n"
+              << add_ns[REPEATS / 2] << "  " << format_ns[REPEATS / 2] << "  " << line_bytes << "  "
+              << line_bytes * 10 * 1000000000ULL / 115200 << "  (dropped " << ring.dropped_count() << ")\n";
+}
+
+/**
+ * Description: Measure one iteration of loop() against the number of doors
+ * moving at the same time. For 1 to DOOR_COUNT doors the client Application
+ * sends the doors open and then closed in one batch each, and every iteration
+ * until they are back is timed. The firmware runs on the virtual clock, only
+ * the time loop() takes on the host is measured.
+ * Pre: None
+ * Post: The table is printed in nanoseconds.
+ */
+static void doors_bench()
+{
+    const unsigned long MOVE_MS = (SERVO_ANGLE_MAX - SERVO_ANGLE_MIN) * SERVO_MS_PER_DEGREE + 1000;
+
+    hal_sim::set_pin(RE_CLK, HIGH);
+    hal_sim::set_pin(RE_DAT, HIGH);
+    hal_sim::set_network_latency_millis(0);
+    std::cout.setstate(std::ios::failbit);
+    setup();
+    for (int i = 0; i < 2000; i++) {
+        hal_sim::advance_millis(1);
+        hal_sim::run_tasks();
+        loop();
+    }
+    std::cout.clear();
+
+    std::cout << "doors  loops  loop p50/p99/max ns  servo writes\n";
+    for (int moving = 1; moving <= DOOR_COUNT; moving++) {
+        std::vector<long> loop_ns;
+        unsigned long writes = hal_sim::servo_writes();
+
+        std::cout.setstate(std::ios::failbit);
+        for (int percent : { 100, 0 }) {
+            std::string commands;
+            for (int door = 0; door < moving; door++) {
+                commands += (door == 0 ? "19:" : ",19:") + std::to_string(percent) + "@" + std::to_string(door);
+            }
+            AppBatch batch;
+            char text[128];
+            parse_batch(commands, batch);
+            batch.token = app_current_token();
+            AppBatch::encode(batch, text, sizeof(text));
+            hal_sim::server_put("app_e", text);
+
+            for (unsigned long ms = 0; ms < MOVE_MS; ms++) {
+                hal_sim::advance_millis(1);
+                hal_sim::run_tasks();
+                auto start = std::chrono::steady_clock::now();
+                loop();
+                auto end = std::chrono::steady_clock::now();
+                loop_ns.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+            }
+        }
+        std::cout.clear();
+
+        size_t count = loop_ns.size();
+        std::sort(loop_ns.begin(), loop_ns.end());
+        std::cout << moving << "  " << count << "  " << loop_ns[count / 2] << '/' << loop_ns[count * 99 / 100]
+                  << '/' << loop_ns[count - 1] << "  " << hal_sim::servo_writes() - writes
+                  << (doors_moving() ? "  (still moving)" : "") << '\n';
+    }
+}
+
+/**
+ * Description: Measure what a poll of app_e costs the device when the client
+ * Application has not written it since the last poll, for the three ways
+ * the poll can go: the value is read and checked again, it is read and found
+ * to have the hash of the last read, or only its version is looked up. The
+ * fake server does not encrypt, so on the ESP32 a read also decrypts.
+ * Pre: None
+ * Post: The medians of the runs are printed in nanoseconds.
+ */
+static void poll_bench()
+{
+    const int REPEATS = 20001;
+    const int POLLS = 100;
+
+    hal_sim::set_pin(RE_CLK, HIGH);
+    hal_sim::set_pin(RE_DAT, HIGH);
+    hal_sim::set_network_latency_millis(0);
+    std::cout.setstate(std::ios::failbit);
+    setup();
+
+    // A batch that was applied already, as app_e holds between commands
+    AppBatch batch;
+    char text[128];
+    parse_batch("19:40", batch);
+    batch.token = app_current_token();
+    AppBatch::encode(batch, text, sizeof(text));
+    hal_sim::server_put("app_e", text);
+    app_event_received(text);
+    std::cout.clear();
+
+    AtSign atsign("@bench");
+    AtClient client(atsign, {});
+    AtKey key("app_e", &atsign, &atsign);
+    uint32_t hash = app_value_hash(text);
+    uint32_t version = 0;
+    net_key_version(&client, &key, version);
+
+    const char* const names[] = { "read and checked", "read, same hash", "version only" };
+    std::vector<long> poll_ns(REPEATS);
+    std::cout << "poll  ns\n";
+    for (int t = 0; t < 3; t++) {
+        unsigned long unchanged = 0;
+        for (int i = 0; i < REPEATS; i++) {
+            auto start = std::chrono::steady_clock::now();
+            for (int j = 0; j < POLLS; j++) {
+                uint32_t seen = 0;
+                if (t == 2) {
+                    unchanged += net_key_version(&client, &key, seen) && seen == version;
+                    continue;
+                }
+                std::string value = client.get_ak(key);
+                if (t == 1) {
+                    unchanged += app_value_hash(value.c_str()) == hash;
+                } else {
+                    // Forget the hash of the last value so it is checked in full
+                    app_event_received("");
+                    app_event_received(value.c_str());
+                }
+            }
+            auto end = std::chrono::steady_clock::now();
+            poll_ns[i] = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / POLLS;
+        }
+        std::nth_element(poll_ns.begin(), poll_ns.begin() + REPEATS / 2, poll_ns.end());
+        std::cout << names[t] << "  " << poll_ns[REPEATS / 2];
+        if (t > 0) {
+            std::cout << "  (" << unchanged << " unchanged)";
+        }
+        std::cout << '\n';
+    }
+}
+
+/**
+ * Description: Measure adding the record of a door cycle to a CycleLog and
+ * encoding an upload of the oldest records, and how many bytes a record
+ * takes in the ring and in an upload against a DoorCycle.
+ * Pre: None
+ * Post: The medians of the runs are printed in nanoseconds.
+ */
+static void cycles_bench()
+{
+    const int REPEATS = 2001;
+    const int RECORDS = 256;
+
+    std::mt19937 random(1);
+    std::vector<DoorCycle> cycles(RECORDS);
+    uint32_t started_at = 1700000000;
+    for (DoorCycle& cycle : cycles) {
+        started_at += 5 + random() % 600;
+        cycle.started_at = started_at;
+        cycle.duration_ms = 100 + random() % 7000;
+        cycle.latency_us = 50 + random() % 2000;
+        cycle.door = (uint8_t)(random() % DOOR_COUNT);
+        cycle.source = (uint8_t)(random() % 4);
+        cycle.opening = random() % 2 == 0;
+        cycle.end = (DoorCycleEnd)(random() % 5);
+    }
+
+    std::vector<long> add_ns(REPEATS);
+    std::vector<long> upload_ns(REPEATS);
+    size_t bytes = 0;
+    size_t held = 0;
+    uint32_t uploaded = 0;
+    size_t text_length = 0;
+    for (int i = 0; i < REPEATS; i++) {
+        CycleLog log;
+        auto start = std::chrono::steady_clock::now();
+        for (const DoorCycle& cycle : cycles) {
+            log.add(cycle, 0);
+        }
+        auto middle = std::chrono::steady_clock::now();
+        char text[NET_VALUE_MAX];
+        uploaded = log.take_upload(text, sizeof(text));
+        auto end = std::chrono::steady_clock::now();
+        add_ns[i] = std::chrono::duration_cast<std::chrono::nanoseconds>(middle - start).count() / RECORDS;
+        upload_ns[i] = std::chrono::duration_cast<std::chrono::nanoseconds>(end - middle).count();
+        bytes = log.bytes_used();
+        held = log.size();
+        text_length = strlen(text);
+    }
+
+    std::nth_element(add_ns.begin(), add_ns.begin() + REPEATS / 2, add_ns.end());
+    std::nth_element(upload_ns.begin(), upload_ns.begin() + REPEATS / 2, upload_ns.end());
+    std::cout << "add ns  upload ns  records held  bytes per record  records per upload\n"
+              << add_ns[REPEATS / 2] << "  " << upload_ns[REPEATS / 2] << "  " << held << " in "
+              << CYCLE_LOG_BYTES << " bytes  " << (double)bytes / held << " (DoorCycle " << sizeof(DoorCycle)
+              << ")  " << uploaded << " in " << text_length << " characters\n";
+}
+
+int main(int argc, char** argv)
+{
+    const char* script = nullptr;
+    unsigned long seed = 1;
+    double hours = 1;
+    unsigned long latency_ms = 200;
+    unsigned long settle_s = 60;
+    const char* persist = nullptr;
+    bool verbose = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string option = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : "";
+        if (option == "--script") {
+            script = value;
+            i++;
+        } else if (option == "--random") {
+            seed = strtoul(value, nullptr, 10);
+            i++;
+        } else if (option == "--hours") {
+            hours = strtod(value, nullptr);
+            i++;
+        } else if (option == "--latency") {
+            latency_ms = strtoul(value, nullptr, 10);
+            i++;
+        } else if (option == "--settle") {
+            settle_s = strtoul(value, nullptr, 10);
+            i++;
+        } else if (option == "--persist") {
+            persist = value;
+            i++;
+        } else if (option == "--trace") {
+            trace = true;
+        } else if (option == "--verbose") {
+            verbose = true;
+        } else if (option == "--bench-bus") {
+            bus_bench();
+            return 0;
+        } else if (option == "--bench-halt") {
+            halt_bench();
+            return 0;
+        } else if (option == "--bench-token") {
+            token_bench();
+            return 0;
+        } else if (option == "--bench-log") {
+            log_bench();
+            return 0;
+        } else if (option == "--bench-doors") {
+            doors_bench();
+            return 0;
+        } else if (option == "--bench-poll") {
+            poll_bench();
+            return 0;
+        } else if (option == "--bench-cycles") {
+            cycles_bench();
+            return 0;
+        } else if (option == "--bench-parser") {
+            parser_bench();
+            return 0;
+        } else if (option == "--fuzz-parser") {
+            unsigned long iterations = *value != '\0' ? strtoul(value, nullptr, 10) : 1000000;
+            return parser_fuzz(iterations) == 0 ? 0 : 1;
+        } else {
+            std::cerr << "unknown option: " << option << '\n';
+            return 2;
+        }
+    }
+
+    if (script != nullptr) {
+        if (!read_script(script, timeline)) {
+            std::cerr << "can not read " << script << '\n';
+            return 2;
+        }
+    } else {
+        random_script(seed, (unsigned long)(hours * 3600000), timeline);
+    }
+    std::stable_sort(timeline.begin(), timeline.end(),
+        [](const SimInput& a, const SimInput& b) { return a.at < b.at; });
+
+    // The firmware prints on every event, only the report is wanted
+    if (!verbose) {
+        std::cout.setstate(std::ios::failbit);
+    }
+
+    // Same start for every run: encoder at rest, network latency
+    hal_sim::set_pin(RE_CLK, HIGH);
+    hal_sim::set_pin(RE_DAT, HIGH);
+    hal_sim::set_network_latency_millis(latency_ms);
+
+    std::string flash_path = persist != nullptr ? std::string(persist) + ".flash" : "";
+    std::string server_path = persist != nullptr ? std::string(persist) + ".server" : "";
+    if (persist != nullptr) {
+        hal_sim::flash_load(flash_path.c_str());
+        hal_sim::server_load(server_path.c_str());
+    }
+    bool warm = flash_size("state") > 0;
+    hal_sim::heap_exclude_current();
+
+    auto start = std::chrono::steady_clock::now();
+
+    setup();
+    booted_at = millis();
+    unsigned long boot_us = micros();
+    bool keys_parsed = hal_sim::keys_reads() > 0;
+    size_t heap_after_setup = heap_free();
+
+    // The firmware waits through the milliseconds it has nothing to do in,
+    // the inputs and the tasks go on meanwhile
+    hal_sim::set_idle_step(step);
+
+    while (next_input < timeline.size()) {
+        tick();
+    }
+    unsigned long settle_until = millis() + settle_s * 1000;
+    while (millis() < settle_until) {
+        tick();
+    }
+    check_settled();
+
+    if (persist != nullptr && !(hal_sim::flash_save(flash_path.c_str()) && hal_sim::server_save(server_path.c_str()))) {
+        std::cerr << "can not write " << persist << '\n';
+    }
+
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    double seconds = std::chrono::duration<double>(elapsed).count();
+
+    std::cerr << "seed:               " << seed << '\n'
+              << "inputs:             " << inputs << '\n'
+              << "virtual time (ms):  " << millis() << '\n'
+              << "wall time (s):      " << seconds << '\n'
+              << "speedup:            " << (seconds > 0 ? millis() / 1000.0 / seconds : 0) << '\n'
+              << "loop iterations:    " << loops << '\n'
+              << "idle ms:            " << hal_sim::idle_micros() / 1000 << '\n'
+              << "boot ms:            " << boot_us / 1000.0 << (warm ? " warm" : " cold")
+              << (keys_parsed ? ", keys file parsed" : ", keys from flash") << '\n'
+              << "servo response ms:  p50 " << servo_response.percentile(50) << " p99 " << servo_response.percentile(99)
+              << " max " << servo_response.max() << " (" << servo_response.count() << ")\n"
+              << "status response ms: p50 " << status_response.percentile(50) << " p99 " << status_response.percentile(99)
+              << " max " << status_response.max() << " (" << status_response.count() << ")\n"
+              << "superseded inputs:  " << superseded << '\n'
+              << "unanswered inputs:  " << unanswered << '\n'
+              << "bus depth:          p50 " << bus_depth.percentile(50) << " p99 " << bus_depth.percentile(99)
+              << " max " << bus_depth.max() << '\n'
+              << "server puts:        " << hal_sim::server_puts() << '\n'
+              << "server gets:        " << hal_sim::server_gets() << '\n'
+              << "server lookups:     " << hal_sim::server_lookups() << '\n'
+              << "notifications:      " << hal_sim::monitor_notifications() << '\n'
+              << "network drops:      " << hal_sim::network_drops() << '\n'
+              << "servo writes:       " << hal_sim::servo_writes() << '\n'
+              << "lcd bus bytes:      " << hal_sim::lcd_bus_bytes() << '\n'
+              << "serial bytes:       " << hal_sim::serial_bytes() << " (blocked "
+              << hal_sim::serial_blocked_micros() / 1000.0 << " ms)\n"
+              << "flash writes:       " << hal_sim::flash_writes() << " (" << hal_sim::flash_bytes_written() << " bytes)\n"
+              << "heap free:          after setup " << heap_after_setup << " end " << heap_free()
+              << " least " << heap_min_free() << '\n'
+              << "violations:         " << violations << '\n';
+
+    std::cout.clear();
+    stats_dump();
+    network_stop();
+
+    return violations == 0 ? 0 : 1;
+}
+
+#endif